@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "Global.hpp"
+
+// Monotonic allocator for things that all die together, e.g. everything
+// parsed during one scan. Allocations are bumped out of large blocks and are
+// never freed one by one; reset() hands the whole arena back at once and
+// keeps its blocks for the next round. Not thread-safe, use one per thread.
+class Arena {
+ private:
+  struct Block {
+    std::unique_ptr<BYTE[]> data;
+    std::size_t size;
+  };
+
+  std::size_t blockSize;
+  std::vector<Block> blocks;
+  std::size_t current = 0;  // block being bumped
+  std::size_t offset = 0;   // first free byte in it
+  std::size_t used = 0;
+
+ public:
+  explicit Arena(std::size_t blockSize = 64 * 1024);
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+  Arena(Arena &&) = default;
+  Arena &operator=(Arena &&) = default;
+
+  void *allocate(std::size_t bytes,
+                 std::size_t alignment = alignof(std::max_align_t));
+
+  template <typename T>
+  T *allocate(std::size_t count) {
+    return (T *)allocate(count * sizeof(T), alignof(T));
+  }
+
+  // Forget every allocation, the blocks are reused
+  void reset();
+  // Forget every allocation and give the blocks back to the system
+  void release();
+
+  std::size_t bytesUsed() const;
+  std::size_t bytesReserved() const;
+};
+
+// Lets standard containers live in an Arena. Without one (the default) it
+// falls back to the heap, so the same types work for long-lived results.
+template <typename T>
+class ArenaAllocator {
+ private:
+  template <typename U>
+  friend class ArenaAllocator;
+
+  Arena *arena = nullptr;
+
+ public:
+  typedef T value_type;
+  typedef std::true_type propagate_on_container_move_assignment;
+  typedef std::true_type propagate_on_container_swap;
+
+  ArenaAllocator() = default;
+  ArenaAllocator(Arena *arena) : arena(arena) {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+  T *allocate(std::size_t count) {
+    if (arena) return arena->allocate<T>(count);
+    return std::allocator<T>().allocate(count);
+  }
+
+  void deallocate(T *pointer, std::size_t count) {
+    if (!arena) std::allocator<T>().deallocate(pointer, count);
+  }
+
+  Arena *getArena() const { return arena; }
+
+  template <typename U>
+  bool operator==(const ArenaAllocator<U> &other) const {
+    return arena == other.arena;
+  }
+  template <typename U>
+  bool operator!=(const ArenaAllocator<U> &other) const {
+    return arena != other.arena;
+  }
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>
+    ArenaString;
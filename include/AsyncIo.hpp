@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "Drive.hpp"
+#include "Global.hpp"
+
+// One sector-range read handed to an AsyncReadEngine. The buffer must hold
+// count * 512 bytes and stay alive until the read completes.
+struct ReadRequest {
+  Index firstSector;
+  Index count;
+  BYTE *buffer;
+  std::uint64_t tag;  // handed back with the completion
+};
+
+struct ReadCompletion {
+  std::uint64_t tag;
+  bool ok;
+};
+
+// Keeps many reads in flight on one device. Submitted reads are batched and
+// only guaranteed to reach the device on the next wait().
+class AsyncReadEngine {
+ public:
+  virtual ~AsyncReadEngine() = default;
+
+  virtual unsigned queueDepth() = 0;
+  virtual unsigned inFlight() = 0;
+
+  // Only valid while inFlight() < queueDepth()
+  virtual void submit(const ReadRequest &request) = 0;
+  // Blocks for the next finished read, returns false if none is in flight
+  virtual bool wait(ReadCompletion &completion) = 0;
+};
+
+// io_uring where the kernel allows it, otherwise a thread pool issuing
+// positioned reads
+std::unique_ptr<AsyncReadEngine> makeAsyncReadEngine(
+    std::shared_ptr<DeviceHandle> device, unsigned queueDepth);
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "Drive.hpp"
+#include "Global.hpp"
+
+struct BlockCacheStats {
+  QWORD hits = 0;
+  QWORD misses = 0;
+  QWORD evictions = 0;
+  std::size_t bytesCached = 0;
+};
+
+// Cluster-granular LRU cache between the filesystem readers and the Drive.
+// Blocks are keyed by cluster number and the budget is given in bytes; a
+// budget of 0 turns the cache into a pass-through.
+class BlockCache {
+ private:
+  struct Block {
+    Index cluster;
+    std::vector<BYTE> data;
+  };
+
+  Drive drive;
+  int sectorsPerCluster;
+  std::size_t byteBudget;
+  BlockCacheStats stats;
+
+  // Most recently used block first
+  std::list<Block> lru;
+  std::unordered_map<Index, std::list<Block>::iterator> blocks;
+  std::mutex mutex;
+
+  void insert(Index cluster, const BYTE *data);
+  void evictToBudget();
+
+ public:
+  BlockCache(Drive drive, int sectorsPerCluster, std::size_t byteBudget);
+
+  void read(Index firstSector, Index count, BYTE *buffer);
+  void setByteBudget(std::size_t byteBudget);
+  void clear();
+  BlockCacheStats getStats();
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+// Blocking FIFO with a fixed capacity, used to hand work between pipeline
+// stages. push() waits while the queue is full, which is what pushes back on
+// a producer that runs ahead of its consumers.
+template <typename T>
+class BoundedQueue {
+ private:
+  std::deque<T> items;
+  std::size_t capacity;
+  bool closed = false;
+
+  std::mutex mutex;
+  std::condition_variable notFull;
+  std::condition_variable notEmpty;
+
+ public:
+  explicit BoundedQueue(std::size_t capacity) : capacity(capacity) {}
+
+  // Returns false (and drops the item) once the queue has been closed
+  bool push(T item) {
+    std::unique_lock<std::mutex> lock(mutex);
+    notFull.wait(lock, [&] { return closed || items.size() < capacity; });
+    if (closed) return false;
+
+    items.push_back(std::move(item));
+    notEmpty.notify_one();
+    return true;
+  }
+
+  // Returns false once the queue is closed and drained
+  bool pop(T &item) {
+    std::unique_lock<std::mutex> lock(mutex);
+    notEmpty.wait(lock, [&] { return closed || !items.empty(); });
+    if (items.empty()) return false;
+
+    item = std::move(items.front());
+    items.pop_front();
+    notFull.notify_one();
+    return true;
+  }
+
+  // Like pop(), but returns false right away instead of waiting
+  bool tryPop(T &item) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (items.empty()) return false;
+
+    item = std::move(items.front());
+    items.pop_front();
+    notFull.notify_one();
+    return true;
+  }
+
+  void close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    closed = true;
+    notFull.notify_all();
+    notEmpty.notify_all();
+  }
+};
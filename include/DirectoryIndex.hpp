@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "Global.hpp"
+#include "NamePool.hpp"
+
+namespace Ntfs {
+
+// Directory tree of a whole volume as flat arrays indexed by MFT record
+// number. Records are added while scanning; finalize() then lays out the
+// children of every directory contiguously (CSR), in record order.
+class DirectoryIndex {
+ public:
+  typedef std::uint32_t RecordId;
+
+  static const Index NoParent = 0xFFFFFFFF;
+
+  // Children of one directory
+  struct ChildRange {
+    const RecordId *first = nullptr;
+    const RecordId *last = nullptr;
+
+    const RecordId *begin() const { return first; }
+    const RecordId *end() const { return last; }
+    std::size_t size() const { return last - first; }
+    bool empty() const { return first == last; }
+  };
+
+  // A named $DATA stream (alternate data stream) of a record
+  struct Stream {
+    RecordId record;
+    NamePool::Handle name;
+    QWORD size;
+  };
+
+  struct StreamRange {
+    const Stream *first = nullptr;
+    const Stream *last = nullptr;
+
+    const Stream *begin() const { return first; }
+    const Stream *end() const { return last; }
+    std::size_t size() const { return last - first; }
+    bool empty() const { return first == last; }
+  };
+
+ private:
+  enum Flag : BYTE { Present = 1, Directory = 2 };
+
+  std::vector<RecordId> parents;
+  std::vector<BYTE> flags;
+  std::vector<NamePool::Handle> nameHandles;
+  // Names of every record and stream, each distinct one once
+  NamePool names;
+
+  // CSR layout: children of id are childList[childStart[id]..childStart[id+1])
+  std::vector<std::uint32_t> childStart;
+  std::vector<RecordId> childList;
+
+  // Sorted by record once finalized
+  std::vector<Stream> streamList;
+
+  bool finalized = false;
+
+  void grow(Index id);
+
+ public:
+  void clear();
+  void reserve(Index records, std::size_t nameUnits = 0);
+
+  // name points at nameLength UTF-16LE code units, e.g. inside a $FILE_NAME.
+  // A parent that was never added itself shows up as a nameless directory.
+  void add(Index id, Index parent, bool isDirectory,
+           const BYTE *name = nullptr, BYTE nameLength = 0);
+  // Records a named stream of id, in any order relative to add()
+  void addStream(Index id, const BYTE *name, BYTE nameLength, QWORD size);
+  void finalize();
+
+  // One past the highest record number in the index
+  Index size() const;
+  bool contains(Index id) const;
+  bool isDirectory(Index id) const;
+  Index getParent(Index id) const;
+  std::u16string_view getName(Index id) const;
+  // Empty until finalize() has run
+  ChildRange children(Index id) const;
+  // Named streams of id, empty until finalize() has run
+  StreamRange streams(Index id) const;
+  std::u16string_view getStreamName(const Stream &stream) const;
+};
+
+}  // namespace Ntfs
@@ -1,18 +1,87 @@
 #pragma once
 
 #include <array>
+#include <cstddef>
 #include <fstream>
+#include <memory>
 #include <string>
 
 #include "Global.hpp"
 
 enum class FileSystem { NTFS, FAT32, Other };
 
+class AsyncReadEngine;
+
+// Long-lived handle on the raw device or image the Drive reads from. Reads
+// are positioned, so a single handle can be shared by every copy of a Drive
+// and used from several threads at once.
+class DeviceHandle {
+ public:
+  virtual ~DeviceHandle() = default;
+
+  virtual void readAt(Index offset, BYTE *buffer, std::size_t length) = 0;
+
+  // Pointer straight into the device if it is memory-mapped, nullptr if the
+  // bytes have to be copied out with readAt()
+  virtual const BYTE *view(Index offset, std::size_t length);
+
+  // POSIX descriptor for engines that submit reads themselves, -1 if none
+  virtual int descriptor();
+};
+
+// Reads through pread (POSIX) or ReadFile with an explicit offset (Windows)
+class FileDevice : public DeviceHandle {
+ private:
+#ifdef _WIN32
+  void *handle;
+#else
+  int fd;
+#endif
+
+ public:
+  explicit FileDevice(const std::string &path);
+
+  FileDevice(const FileDevice &) = delete;
+  FileDevice &operator=(const FileDevice &) = delete;
+
+  ~FileDevice() override;
+
+  void readAt(Index offset, BYTE *buffer, std::size_t length) override;
+#ifndef _WIN32
+  int descriptor() override;
+#endif
+};
+
+// Maps a whole disk image (or block device) read-only into memory
+class MappedDevice : public DeviceHandle {
+ private:
+#ifdef _WIN32
+  void *handle;
+  void *mapping;
+#else
+  int fd;
+#endif
+  const BYTE *base = nullptr;
+  Index size = 0;
+
+ public:
+  explicit MappedDevice(const std::string &path);
+
+  MappedDevice(const MappedDevice &) = delete;
+  MappedDevice &operator=(const MappedDevice &) = delete;
+
+  ~MappedDevice() override;
+
+  void readAt(Index offset, BYTE *buffer, std::size_t length) override;
+  const BYTE *view(Index offset, std::size_t length) override;
+};
+
 class Drive {
  private:
   std::string name;
   std::string driveAccess;
   FileSystem fileSytem;
+  std::shared_ptr<DeviceHandle> device;
 
  public:
   Drive() = default;
@@ -20,8 +89,16 @@ class Drive {
   ~Drive() = default;
 
   std::string getName();
+  // Takes a drive letter on Windows, or the path of a disk image / block
+  // device, which is memory-mapped
   void configure(std::string drive);
   void readSector(Index readPoint, Sector &sector);
+  // Fill buffer (count * 512 bytes, owned by the caller) with one request
+  void readRange(Index firstSector, Index count, BYTE *buffer);
+  // Zero-copy access to a sector range, nullptr unless the drive is mapped
+  const BYTE *viewRange(Index firstSector, Index count);
+  // Engine that keeps up to queueDepth reads in flight on this drive
+  std::unique_ptr<AsyncReadEngine> createAsyncEngine(unsigned queueDepth = 64);
   void readSector(Index readPoint, std::ifstream &ifs);
   FileSystem getFileSystem();
 };
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "Global.hpp"
+#include "MftRecordView.hpp"
+
+namespace Ntfs {
+
+// Where each cluster of a non-resident attribute lives, built once from its
+// decoded run list. Runs that continue each other on disk are merged, starts
+// are kept prefix-summed and clusters absolute, so mapping a VCN is a binary
+// search rather than a walk summing the relative runs.
+class ExtentMap {
+ public:
+  static const QWORD Sparse = ~0ull;
+
+  struct Extent {
+    QWORD vcn;
+    QWORD lcn;  // Sparse for a hole
+    QWORD clusterCount;
+
+    bool isSparse() const { return lcn == Sparse; }
+  };
+
+ private:
+  // One more start than there are extents, the last is the cluster count
+  std::vector<QWORD> vcnStarts = {0};
+  std::vector<QWORD> lcns;
+  QWORD runCluster = 0;  // the relative runs summed so far
+
+ public:
+  ExtentMap() = default;
+
+  template <typename Runs>
+  explicit ExtentMap(const Runs &runs) {
+    for (const DataRun &run : runs) add(run);
+  }
+
+  void clear();
+  // Runs go in the order of the run list
+  void add(const DataRun &run);
+
+  std::size_t size() const { return lcns.size(); }
+  bool empty() const { return lcns.empty(); }
+  QWORD clusterCount() const { return vcnStarts.back(); }
+
+  Extent operator[](std::size_t i) const;
+  // The extent vcn is in, cut to start at it. Past the end, the extent has no
+  // clusters.
+  Extent find(QWORD vcn) const;
+};
+
+}  // namespace Ntfs
@@ -1,9 +1,15 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
 
 typedef unsigned char BYTE;
+#ifdef _WIN32
 typedef unsigned long DWORD;
+#else
+// unsigned long is 64-bit on LP64 platforms
+typedef std::uint32_t DWORD;
+#endif
 typedef unsigned long long QWORD;
 typedef unsigned short WORD;
 typedef unsigned long long Index;
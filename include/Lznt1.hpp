@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+
+#include "Global.hpp"
+
+namespace Ntfs {
+
+// Decompresses one LZNT1 stream, i.e. the clusters a compressed unit of a
+// compressed attribute holds, into out. Returns how many bytes were written;
+// the unit is shorter than outLength when its end is all zeros, which is left
+// to the caller to fill in. Throws on corrupt input.
+std::size_t decompressLznt1(const BYTE *in, std::size_t inLength, BYTE *out,
+                            std::size_t outLength);
+
+}  // namespace Ntfs
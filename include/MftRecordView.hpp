@@ -0,0 +1,209 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Global.hpp"
+
+namespace Ntfs {
+
+// firstCluster is relative to the previous run's, as stored on disk, and can
+// be negative. Sparse runs have no clusters on disk (and a firstCluster of 0).
+struct DataRun {
+  QWORD clusterCount;
+  std::int64_t firstCluster;
+  bool sparse = false;
+};
+
+// --- Run lists ---
+
+// Decodes up to capacity runs from pos into runs and returns how many were
+// written. pos is left on the first run not decoded, or set to null once the
+// list ends (or turns out corrupt), so a long list can be done in batches.
+std::size_t decodeDataRuns(const BYTE *&pos, const BYTE *limit, DataRun *runs,
+                           std::size_t capacity);
+
+// --- Update sequence ---
+
+enum class FixupResult { Ok, Torn, Invalid };
+
+// Puts back the real last two bytes of every 512-byte stride of a FILE or
+// INDX block, in place. Torn means a stride did not end with the update
+// sequence number, i.e. it was written separately from the rest; the bytes
+// are restored anyway. Invalid leaves the buffer alone.
+FixupResult applyFixup(BYTE *block, std::size_t size);
+
+// --- Views over the raw bytes of one MFT record ---
+// None of these own or copy anything: they are only valid while the record
+// buffer they were made from is, and every field is decoded when asked for.
+
+// Decodes a run list one run at a time
+class DataRunIterator {
+ private:
+  const BYTE *pos = nullptr;   // current run, null at the end
+  const BYTE *next = nullptr;  // the one after it
+  const BYTE *limit = nullptr;
+  DataRun run = {0, 0, false};
+
+  void decode();
+
+ public:
+  DataRunIterator() = default;
+  // Runs start at runList; limit is the end of the attribute holding them
+  DataRunIterator(const BYTE *runList, const BYTE *limit);
+
+  const DataRun &operator*() const { return run; }
+  const DataRun *operator->() const { return &run; }
+  DataRunIterator &operator++();
+  bool operator==(const DataRunIterator &other) const {
+    return pos == other.pos;
+  }
+  bool operator!=(const DataRunIterator &other) const {
+    return pos != other.pos;
+  }
+};
+
+struct DataRunRange {
+  DataRunIterator first;
+  DataRunIterator last;
+
+  DataRunIterator begin() const { return first; }
+  DataRunIterator end() const { return last; }
+  bool empty() const { return first == last; }
+};
+
+class AttributeView {
+ private:
+  const BYTE *attr = nullptr;
+
+ public:
+  AttributeView() = default;
+  explicit AttributeView(const BYTE *attr) : attr(attr) {}
+
+  // False for the view of an attribute that was not found
+  bool isValid() const { return attr != nullptr; }
+  const BYTE *data() const { return attr; }
+
+  DWORD type() const;
+  DWORD length() const;
+  bool isNonResident() const;
+  // Name in UTF-16LE code units, 0 for the unnamed attribute
+  BYTE nameLength() const;
+  const BYTE *name() const;
+
+  // --- Resident ---
+  DWORD valueLength() const;
+  const BYTE *value() const;
+
+  // --- Non resident ---
+  // First cluster of the attribute this one holds a part of, 0 if resident
+  QWORD lowestVcn() const;
+  QWORD allocatedSize() const;
+  QWORD realSize() const;
+  // Raw run list, which ends with the attribute; null if resident
+  const BYTE *runList() const;
+  DataRunRange dataRuns() const;
+};
+
+class AttributeIterator {
+ private:
+  static const std::size_t End = (std::size_t)-1;
+
+  const BYTE *record = nullptr;
+  std::size_t offset = End;
+  std::size_t limit = 0;  // end of the used part of the record
+
+  // Moves to the end if the attribute at offset can't be trusted
+  void check();
+
+ public:
+  AttributeIterator() = default;
+  AttributeIterator(const BYTE *record, std::size_t offset, std::size_t limit);
+
+  AttributeView operator*() const { return AttributeView(record + offset); }
+  AttributeIterator &operator++();
+  bool operator==(const AttributeIterator &other) const {
+    return offset == other.offset;
+  }
+  bool operator!=(const AttributeIterator &other) const {
+    return offset != other.offset;
+  }
+};
+
+struct AttributeRange {
+  AttributeIterator first;
+  AttributeIterator last;
+
+  AttributeIterator begin() const { return first; }
+  AttributeIterator end() const { return last; }
+};
+
+// Value of a $FILE_NAME attribute
+class FileNameView {
+ private:
+  const BYTE *value = nullptr;
+
+ public:
+  FileNameView() = default;
+  explicit FileNameView(const BYTE *value) : value(value) {}
+
+  bool isValid() const { return value != nullptr; }
+
+  Index parent() const;  // 6 first byte
+  DWORD flags() const;
+  // In UTF-16LE code units
+  BYTE nameLength() const;
+  // 0 POSIX, 1 Win32, 2 DOS, 3 Win32 & DOS
+  BYTE nameNamespace() const;
+  const BYTE *name() const;
+};
+
+// Value of a $STANDARD_INFORMATION attribute
+class StandardInfoView {
+ private:
+  const BYTE *value = nullptr;
+
+ public:
+  StandardInfoView() = default;
+  explicit StandardInfoView(const BYTE *value) : value(value) {}
+
+  bool isValid() const { return value != nullptr; }
+
+  QWORD createdTime() const;
+  QWORD modifiedTime() const;
+  QWORD mftModifiedTime() const;
+  QWORD accessedTime() const;
+  DWORD flags() const;
+};
+
+class MftRecordView {
+ private:
+  const BYTE *record = nullptr;
+  std::size_t size = 0;
+
+ public:
+  MftRecordView() = default;
+  MftRecordView(const BYTE *record, std::size_t size);
+
+  const BYTE *data() const { return record; }
+
+  // Has the FILE signature and a sane header
+  bool isValid() const;
+  bool isInUse() const;
+  bool isDirectory() const;
+  DWORD recordNumber() const;
+  // Record this one extends through an $ATTRIBUTE_LIST, 0 for base records
+  Index baseRecord() const;
+
+  AttributeRange attributes() const;
+  // First attribute of that type, invalid view if there is none
+  AttributeView find(DWORD type) const;
+
+  // The long name if the record has both a DOS and a long one
+  FileNameView fileName() const;
+  StandardInfoView standardInfo() const;
+  // Runs of the unnamed $DATA, empty if it is resident or missing
+  DataRunRange dataRuns() const;
+};
+
+}  // namespace Ntfs
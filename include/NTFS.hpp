@@ -1,23 +1,31 @@
 #pragma once
 
+#include <cstddef>
+#include <exception>
 #include <fstream>
+#include <functional>
+#include <future>
+#include <memory>
+#include <ostream>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
 
+#include "Arena.hpp"
+#include "AsyncIo.hpp"
+#include "BlockCache.hpp"
+#include "DirectoryIndex.hpp"
 #include "Drive.hpp"
+#include "ExtentMap.hpp"
 #include "Global.hpp"
 #include "IReader.hpp"
+#include "MftRecordView.hpp"
+#include "ThreadPool.hpp"
 
 namespace Ntfs {
 
 enum class MftEntryAvailability { InUse, NotInUse, Invalid };
 
-struct DataRun {
-  QWORD clusterCount;
-  QWORD firstCluster;
-};
-
 struct FileAttr {
   bool readOnly = false;
   bool hidden = false;
@@ -36,10 +44,12 @@ struct FileAttr {
   bool indexView = false;
 };
 
-// Only necessary information is actually saved
+// Only necessary information is actually saved. Strings and vectors below
+// live in the Arena given to readMftEntry(), or on the heap without one.
 struct AttributeHeader {
   bool isNonResident = false;
-  std::string name;
+  // UTF-16LE bytes, empty for the unnamed attribute
+  ArenaString name;
 };
 struct StandardInformationAttribute {
   AttributeHeader header;
@@ -53,7 +63,7 @@ struct FileNameAttribute {
 
   Index parent;  // 6 first byte
   FileAttr fileAttr;
-  std::vector<BYTE> fileName;
+  ArenaVector<BYTE> fileName;  // UTF-16LE bytes
   bool containsUnicode = false;
 };
 
@@ -62,10 +72,18 @@ struct DataAttribute {
 
   // if it's resident
   DWORD residentDataSize;
+  // Where the content starts in MftEntry::records
+  DWORD residentDataOffset = 0;
 
   // if it's non resident
   QWORD realSize;
-  std::vector<DataRun> dataRuns;
+  // Clusters reserved for the content, holes of sparse files included
+  QWORD allocatedSize = 0;
+  // Bytes the runs occupy on disk, holes left out
+  QWORD diskSize = 0;
+  // log2 of the clusters per compression unit, 0 if not compressed
+  BYTE compressionUnit = 0;
+  ArenaVector<DataRun> dataRuns;
 };
 
 struct MftEntryHeader {
@@ -79,17 +97,73 @@ struct MftEntry {
 
   StandardInformationAttribute stdInfoAttr;
   FileNameAttribute fileNameAttr;
-  std::vector<DataAttribute> dataAttrs;
+  ArenaVector<DataAttribute> dataAttrs;
+  // The record as loaded, followed by its extension records if any. Resident
+  // content is read from here rather than from the disk again.
+  ArenaVector<BYTE> records;
+
+  // Content of a resident attribute of this entry, no copy made
+  const BYTE* residentData(const DataAttribute& data) const {
+    return records.data() + data.residentDataOffset;
+  }
 };
 
-// This represent a file or directory
-struct DirectoryNode {
+// One child of a directory, straight from the directory's index
+struct DirectoryEntry {
   Index id;
   bool isDirectory = false;
-  std::vector<Index> children;
+  // As of the last time the index was updated, may lag behind $DATA
+  QWORD realSize = 0;
+  std::u16string name;
+};
+
+// What tree generation needs out of one record. name points into the record
+// buffer it was parsed from.
+struct NodeRecord {
+  Index id;
+  Index parent;
+  bool hasParent = false;
+  bool isDirectory = false;
+  const BYTE* name = nullptr;
+  BYTE nameLength = 0;
+};
+
+// A named $DATA stream found while scanning. name points into the record
+// buffer it was parsed from.
+struct StreamRecord {
+  Index id;  // the file's base record, also for streams in extension records
+  const BYTE* name;
+  BYTE nameLength;
+  QWORD size;
 };
 
-typedef std::unordered_map<Index, DirectoryNode*> HashMap;
+// Output of the parse stage for one RecordRange
+struct ParsedChunk {
+  std::size_t index;  // position of the range in the scan
+  std::size_t slot;   // read buffer the range was loaded into
+  ArenaVector<NodeRecord> nodes;  // in the arena of the chunk's slot
+  ArenaVector<StreamRecord> streams;
+  Index tornRecords = 0;
+  std::exception_ptr error;
+};
+
+// A contiguous stretch of $MFT records on disk
+struct RecordRange {
+  Index firstRecord;
+  Index firstSector;
+  Index recordCount;
+};
+
+// Receives a file's content in order, one chunk at a time. The bytes are
+// only valid for the duration of the call.
+typedef std::function<void(const BYTE* data, std::size_t length)> ChunkSink;
+// Told about a hole of length zero bytes in place of a chunk of zeros
+typedef std::function<void(QWORD length)> HoleSink;
+
+// Called for the $MFT's record slots in record order, skipping the ones
+// $MFT:$BITMAP marks as unused and torn ones. The record bytes have their
+// fixups applied and are only valid for the duration of the call.
+typedef std::function<void(Index recordNum, const BYTE* record)> RecordVisitor;
 
 // BIOS Parameter Block
 struct BPB {
@@ -122,6 +196,65 @@ struct PBS {
   std::vector<BYTE> bootstrapCode;
 };
 
+// Random access to the unnamed $DATA of one file, from Reader::openFile().
+// Reads go through the reader's block cache; once they follow each other,
+// the clusters ahead are fetched into the cache in the background. Not
+// thread-safe, use one handle per thread.
+class FileHandle {
+ private:
+  friend class Reader;
+
+  std::shared_ptr<BlockCache> cache;
+  int sectorsPerCluster = 0;
+  QWORD fileSize = 0;
+
+  bool resident = false;
+  std::vector<BYTE> residentData;
+  // Shared with the read-ahead task, which may outlive a moved-from handle
+  std::shared_ptr<const ExtentMap> extents;
+  std::vector<BYTE> scratch;  // for reads that don't cover whole sectors
+
+  // --- Read-ahead ---
+  static constexpr std::size_t MaxReadAhead = 4 * 1024 * 1024;
+
+  bool canPrefetch = false;
+  QWORD nextOffset = 0;      // where a sequential read would start
+  unsigned streak = 0;       // reads in a row that started there
+  QWORD prefetchedTo = 0;    // end of what was last asked for
+  std::size_t window = 0;    // grows while the reads stay sequential
+  std::future<void> prefetch;
+
+  void readAhead();
+
+ public:
+  FileHandle() = default;
+
+  QWORD size() const;
+  // Like pread: copies up to length bytes from offset on into buffer and
+  // returns how many, fewer at the end of the file
+  std::size_t read(QWORD offset, BYTE* buffer, std::size_t length);
+};
+
+// Holds something one Reader object uses for itself. A copy starts out
+// empty and makes its own when it needs one, so copies of a reader can be
+// used from different threads.
+template <typename T>
+class Unshared {
+ private:
+  std::unique_ptr<T> object;
+
+ public:
+  Unshared() = default;
+  Unshared(const Unshared&) {}
+  Unshared& operator=(const Unshared&) {
+    object.reset();
+    return *this;
+  }
+
+  T* get() const { return object.get(); }
+  void reset(T* value = nullptr) { object.reset(value); }
+};
+
 class Reader {
  private:
   Drive curDrive;
@@ -129,9 +262,76 @@ class Reader {
   bool hasRead = false;
   int entrySize;
 
-  // DataRun readBitmap(std::ifstream& bitmapStream);
-  std::vector<DataRun> Reader::getEntrySegments();
-  MftEntryAvailability createNode(Index sectorNum, HashMap& map);
+  std::vector<BYTE> mftBitmap;
+  bool bitmapLoaded = false;
+  // Where the $MFT's records are on disk, one extent per data run
+  std::vector<RecordRange> mftExtents;
+  // Record slots in the $MFT's data runs, known with mftExtents
+  Index mftRecordCount = 0;
+
+  // Shared between copies of the reader, rebuilt on every read()
+  std::shared_ptr<BlockCache> cache;
+  std::size_t cacheBudget = 64 * 1024 * 1024;
+
+  // Workers used by generateDirectoryTree, 0 = one per hardware thread
+  unsigned threadCount = 0;
+  // Decompresses the units of compressed files, made on first use with
+  // threadCount workers
+  Unshared<ThreadPool> decompressPool;
+  // Reads kept in flight on the device while generating the tree or
+  // streaming a file
+  unsigned ioDepth = 32;
+  // Engine for those reads, made on first use and kept until the drive or
+  // the depth changes. Nothing is in flight on it between calls.
+  Unshared<AsyncReadEngine> readEngine;
+
+  // Records whose update sequence did not match during the last scan
+  Index tornRecords = 0;
+
+  AsyncReadEngine& getEngine();
+  // Waits out the reads still in flight after an error. Drops the engine if
+  // even that fails.
+  void drainEngine();
+  // Copies one record into buffer (getRecordSize() bytes) and applies its
+  // update sequence fixup
+  FixupResult loadEntry(Index sectorNum, BYTE* buffer);
+  // Loads $MFT:$BITMAP, one bit per record telling whether it is in use
+  void readBitmap();
+  // Per the loaded $BITMAP, always true if there is none
+  bool isRecordInUse(Index recordNum) const;
+  // Runs of the $MFT's unnamed $DATA, those in extension records included
+  ArenaVector<DataRun> Reader::getEntrySegments();
+  const std::vector<RecordRange>& getMftExtents();
+  // Sets mftExtents and mftRecordCount from the $MFT's runs
+  void setMftExtents(const ArenaVector<DataRun>& runs);
+  Index getRecordSector(Index recordNum);
+  // Reads the extension records an $ATTRIBUTE_LIST points at into buffer,
+  // one after the other, and returns how many there are
+  Index loadExtensions(const AttributeView& list, Index baseRecord,
+                       std::vector<BYTE>& buffer);
+  // Attributes of a base record and its extension records, with the parts of
+  // split attributes in VCN order. Views point into record and extensions.
+  void collectAttributes(const MftRecordView& record,
+                         std::vector<BYTE>& extensions,
+                         std::vector<AttributeView>& attrs);
+  // Appends the runs of one part of a split attribute
+  void appendRuns(const AttributeView& piece, ArenaVector<DataRun>& runs);
+  // Reads count clusters from vcn on of a non-resident attribute
+  void readClusters(const ExtentMap& extents, QWORD vcn, QWORD count,
+                    BYTE* buffer);
+  // readFile() for a compressed attribute, a batch of units at a time
+  void readCompressed(const DataAttribute& data, const ChunkSink& sink,
+                      const HoleSink& hole, std::size_t bufferBytes);
+  MftEntryAvailability parseNode(const BYTE* entryRaw, NodeRecord& node);
+  void insertNode(const NodeRecord& node, DirectoryIndex& index);
+  // Named $DATA streams of an in-use record, base or extension
+  void parseStreams(const BYTE* entryRaw, ArenaVector<StreamRecord>& streams);
+  void insertStream(const StreamRecord& stream, DirectoryIndex& index);
+  // Splits the $MFT's data runs into ranges of at most maxRecords records,
+  // leaving out stretches that $MFT:$BITMAP marks as unused
+  std::vector<RecordRange> splitMft(Index maxRecords);
+  // Reads a range into buffer, fixups are left to the caller
+  BYTE* loadRange(const RecordRange& range, std::vector<BYTE>& buffer);
 
  public:
   Reader() = default;
@@ -139,13 +339,61 @@ class Reader {
   ~Reader() = default;
 
   PBS getPbs();
+  void setCacheBudget(std::size_t bytes);
+  BlockCacheStats getCacheStats();
 
   void read(Drive drive);
   void refresh();
-  void Reader::generateDirectoryTree(HashMap& map);
+  // 1 parses on the calling thread, 0 uses every hardware thread
+  void setThreadCount(unsigned count);
+  void setIoDepth(unsigned depth);
+  // Streams the $MFT's data runs in large sequential chunks
+  void scanMft(const RecordVisitor& visitor,
+               std::size_t chunkBytes = 4 * 1024 * 1024);
+  void Reader::generateDirectoryTree(DirectoryIndex& index);
+  // Reads the children of one directory from its $I30 index, in the
+  // directory's sort order, without scanning the $MFT
+  std::vector<DirectoryEntry> listDirectory(Index recordNum);
+  // Streams the unnamed $DATA of entry to sink, holding at most bufferBytes
+  // of it at once. Non-resident content is read straight from the device in
+  // sequential reads, up to setIoDepth() of them kept in flight.
+  void readFile(const MftEntry& entry, const ChunkSink& sink,
+                std::size_t bufferBytes = 4 * 1024 * 1024);
+  // Same, but sparse runs go to hole instead of being written out as zeros.
+  // Neither ever reads the device for a hole.
+  void readFile(const MftEntry& entry, const ChunkSink& sink,
+                const HoleSink& hole,
+                std::size_t bufferBytes = 4 * 1024 * 1024);
+  // Same for any $DATA of entry, named streams included
+  void readFile(const MftEntry& entry, const DataAttribute& data,
+                const ChunkSink& sink, const HoleSink& hole,
+                std::size_t bufferBytes = 4 * 1024 * 1024);
+  // Streams the $DATA named name (UTF-16), e.g. u"Zone.Identifier"; an empty
+  // name is the file's content
+  void readStream(const MftEntry& entry, std::u16string_view name,
+                  const ChunkSink& sink,
+                  std::size_t bufferBytes = 4 * 1024 * 1024);
+  void readFile(const MftEntry& entry, std::ostream& out);
+  // POSIX file descriptor (or CRT one on Windows). Holes are seeked over
+  // when the descriptor allows it, so the copy is sparse too.
+  void readFile(const MftEntry& entry, int fd);
+  // Handle to read the unnamed $DATA of a record at any offset
+  FileHandle openFile(Index recordNum);
+  // Whole content in memory, only meant for small files
   std::string Reader::readFile(MftEntry entry);
   void getSectorNum(Index entryId);
-  MftEntryAvailability readMftEntry(Index id, MftEntry& entry);
+  // With an arena, the record and everything the entry holds are allocated
+  // from it and stay valid until it is reset
+  MftEntryAvailability readMftEntry(Index id, MftEntry& entry,
+                                    Arena* arena = nullptr);
+  // Same record without parsing anything up front. The view points into a
+  // fixed-up copy in the arena, even for a mapped image.
+  MftRecordView viewMftEntry(Index sectorNum, Arena& arena);
+  // Bytes per record, e.g. to view the records scanMft() visits
+  std::size_t getRecordSize();
+  // Records the last scan skipped because they were torn, i.e. their
+  // sectors came from different writes
+  Index getTornRecords();
 };
 
 }  // namespace Ntfs
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "Global.hpp"
+
+namespace Ntfs {
+
+// Every name of a scan in one UTF-16 buffer, each distinct name stored once.
+// A name is then a small handle instead of an allocation of its own, and the
+// many files called e.g. "desktop.ini" all share the same code units.
+class NamePool {
+ public:
+  struct Handle {
+    std::uint32_t offset = 0;
+    BYTE length = 0;  // in code units, NTFS names are at most 255 of them
+  };
+
+ private:
+  std::vector<char16_t> units;
+  // Open addressing over the distinct names, a handle of length 0 is a free
+  // slot. Kept at most half full.
+  std::vector<Handle> table;
+  std::size_t distinct = 0;
+
+  static std::size_t hash(const char16_t *name, std::size_t length);
+  void rehash(std::size_t capacity);
+
+ public:
+  void clear();
+  void reserve(std::size_t codeUnits);
+
+  // name points at length UTF-16LE code units, e.g. inside a $FILE_NAME
+  Handle add(const BYTE *name, BYTE length);
+  // Valid until the next add()
+  std::u16string_view get(Handle handle) const;
+
+  // Code units stored, after duplicates were left out
+  std::size_t size() const;
+};
+
+}  // namespace Ntfs
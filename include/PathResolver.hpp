@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "DirectoryIndex.hpp"
+#include "Global.hpp"
+
+namespace Ntfs {
+
+// Full paths of the records in a DirectoryIndex, without touching the disk.
+// Each directory is resolved once, to its parent's entry and the length of
+// its path, and its name stays interned in the index. A path is only spelled
+// out when asked for, back to front into space reserved up front, so it
+// costs as much as its length.
+class PathResolver {
+ public:
+  // Record of the root directory, its path is empty
+  static const Index Root = 5;
+
+ private:
+  struct Directory {
+    Index id;
+    std::uint32_t parent;  // 1 + its entry in directories, 0 at the top
+    std::uint32_t length;  // of the whole path
+  };
+
+  const DirectoryIndex &index;
+  char16_t separator;
+
+  // Per record, 1 + its entry in directories, 0 until it is resolved
+  std::vector<std::uint32_t> slots;
+  std::vector<Directory> directories;
+  std::vector<Index> chain;  // scratch for resolve()
+  std::u16string scratch;    // for directoryPath()
+
+  // Entry of a directory, resolving it and the parents it needs; 0 if the
+  // record is not in the index
+  std::uint32_t resolve(Index id);
+  // Spells out the path of a resolved directory at the end of out
+  void appendDirectory(std::uint32_t slot, std::u16string &out);
+
+ public:
+  // index has to stay alive and unchanged while the resolver is used
+  explicit PathResolver(const DirectoryIndex &index, char16_t separator = u'/');
+
+  // Path of a directory, e.g. u"/docs/sub". Only valid until the next call.
+  std::u16string_view directoryPath(Index id);
+  // Appends the full path of any record to out
+  void appendPath(Index id, std::u16string &out);
+  std::u16string getPath(Index id);
+};
+
+}  // namespace Ntfs
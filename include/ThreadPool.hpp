@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size work-stealing pool. Every worker owns a deque: it pops its own
+// tasks from the front and steals from the back of the others when it runs
+// dry. Tasks submitted from inside a task stay on the submitting worker.
+class ThreadPool {
+ private:
+  struct Queue {
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+  };
+
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> workers;
+
+  std::mutex stateMutex;
+  std::condition_variable wakeUp;
+  std::condition_variable allDone;
+  std::size_t queued = 0;   // tasks sitting in a deque
+  std::size_t pending = 0;  // tasks submitted but not finished
+  bool stopping = false;
+  std::exception_ptr firstError;
+
+  std::atomic<std::size_t> nextQueue{0};
+
+  bool runOne(std::size_t self);
+  void workerLoop(std::size_t self);
+
+ public:
+  // 0 picks one thread per hardware thread
+  explicit ThreadPool(unsigned threadCount = 0);
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  ~ThreadPool();
+
+  unsigned size() const;
+  void submit(std::function<void()> task);
+  // Blocks until every submitted task has finished, then rethrows the first
+  // exception a task threw. Must not be called from inside a task.
+  void wait();
+};
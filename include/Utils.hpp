@@ -1,9 +1,8 @@
 #pragma once
 
 #include <chrono>
-#include <codecvt>
-#include <locale>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "Global.hpp"
@@ -26,11 +25,19 @@ T readLittleEndianVal(const std::vector<BYTE> &byteArr, int start);
 Index readLittleEndianVal(const std::vector<BYTE> &byteArr, int start,
                           int length);
 
+// Overloads over raw memory, e.g. a record inside a memory-mapped image
+template <typename T>
+T readLittleEndianVal(const BYTE *bytes, int start);
+
+Index readLittleEndianVal(const BYTE *bytes, int start, int length);
+
 std::string readString(const Sector &sector, int start, int length);
 std::string readString(const std::vector<BYTE> &byteArr, int start, int length);
+std::string readString(const BYTE *bytes, int start, int length);
 
 std::vector<BYTE> readRawString(const std::vector<BYTE> &byteArr, int start,
                                 int length);
+std::vector<BYTE> readRawString(const BYTE *bytes, int start, int length);
 
 std::vector<BYTE> readRawWString(const std::vector<BYTE> &byteArr, int start,
                                  int length);
@@ -50,14 +57,13 @@ std::string filetimeToFormattedString(std::uint64_t fileTime);
 
 int countSetBits(int N);
 
-std::wstring StringToWString(std::string str) {
-  std::wstring result;
-
-  std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
-  std::string narrow = converter.to_bytes(result);
-  std::wstring wide = converter.from_bytes(str);
+// UTF-8 in, invalid sequences become U+FFFD
+std::wstring StringToWString(std::string str);
 
-  return result;
-}
+// --- UTF-16, as NTFS names are ---
+// Unpaired surrogates become U+FFFD
+void appendUtf8(std::u16string_view text, std::string &out);
+std::string utf16ToUtf8(std::u16string_view text);
+std::wstring utf16ToWString(std::u16string_view text);
 
 }  // namespace Utils
@@ -0,0 +1,58 @@
+#include "Arena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+
+#include "Global.hpp"
+
+Arena::Arena(std::size_t blockSize) : blockSize(blockSize) {}
+
+void *Arena::allocate(std::size_t bytes, std::size_t alignment) {
+  if (bytes == 0) bytes = 1;
+
+  // --- Try the current block, then the ones kept from before a reset ---
+  while (current < blocks.size()) {
+    Block &block = blocks[current];
+    std::uintptr_t base = (std::uintptr_t)block.data.get();
+    std::size_t aligned =
+        ((base + offset + alignment - 1) & ~(alignment - 1)) - base;
+
+    if (aligned + bytes <= block.size) {
+      offset = aligned + bytes;
+      used += bytes;
+      return block.data.get() + aligned;
+    }
+
+    ++current;
+    offset = 0;
+  }
+
+  // --- Out of room: add a block, a dedicated one for big requests ---
+  std::size_t size = std::max(blockSize, bytes + alignment);
+  blocks.push_back({std::unique_ptr<BYTE[]>(new BYTE[size]), size});
+  current = blocks.size() - 1;
+  offset = 0;
+
+  return allocate(bytes, alignment);
+}
+
+void Arena::reset() {
+  current = 0;
+  offset = 0;
+  used = 0;
+}
+
+void Arena::release() {
+  blocks.clear();
+  reset();
+}
+
+std::size_t Arena::bytesUsed() const { return used; }
+
+std::size_t Arena::bytesReserved() const {
+  std::size_t total = 0;
+  for (const Block &block : blocks) total += block.size;
+
+  return total;
+}
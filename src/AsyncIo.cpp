@@ -0,0 +1,308 @@
+#include "AsyncIo.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "Drive.hpp"
+#include "Global.hpp"
+#include "ThreadPool.hpp"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define FS_READER_IO_URING 1
+#endif
+#endif
+
+#ifdef FS_READER_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#endif
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter 426
+#endif
+#endif
+
+namespace {
+
+// --- Fallback: positioned reads on a thread pool ---
+
+class PoolReadEngine : public AsyncReadEngine {
+ private:
+  std::shared_ptr<DeviceHandle> device;
+  unsigned depth;
+  unsigned inFlightCount = 0;
+
+  std::mutex mutex;
+  std::condition_variable finished;
+  std::deque<ReadCompletion> completed;
+
+  // Declared last so its workers are gone before the members they use
+  ThreadPool pool;
+
+ public:
+  PoolReadEngine(std::shared_ptr<DeviceHandle> device, unsigned depth)
+      : device(device), depth(depth), pool(std::min(depth, 16u)) {}
+
+  unsigned queueDepth() override { return depth; }
+  unsigned inFlight() override { return inFlightCount; }
+
+  void submit(const ReadRequest &request) override {
+    ++inFlightCount;
+
+    pool.submit([this, request] {
+      bool ok = true;
+      try {
+        device->readAt(request.firstSector * 512, request.buffer,
+                       request.count * 512);
+      } catch (std::runtime_error &) {
+        ok = false;
+      }
+
+      std::lock_guard<std::mutex> lock(mutex);
+      completed.push_back({request.tag, ok});
+      finished.notify_one();
+    });
+  }
+
+  bool wait(ReadCompletion &completion) override {
+    if (inFlightCount == 0) return false;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&] { return !completed.empty(); });
+
+    completion = completed.front();
+    completed.pop_front();
+    --inFlightCount;
+    return true;
+  }
+};
+
+#ifdef FS_READER_IO_URING
+
+// --- io_uring, driven through the raw syscalls ---
+
+class UringReadEngine : public AsyncReadEngine {
+ private:
+  struct Slot {
+    ReadRequest request;
+    iovec iov;
+    std::size_t doneBytes;
+  };
+
+  int fd;
+  int ringFd = -1;
+  unsigned depth;
+  unsigned inFlightCount = 0;
+  unsigned toSubmit = 0;
+
+  void *sqRing = MAP_FAILED;
+  std::size_t sqRingSize = 0;
+  void *cqRing = MAP_FAILED;
+  std::size_t cqRingSize = 0;
+  io_uring_sqe *sqes = (io_uring_sqe *)MAP_FAILED;
+  std::size_t sqesSize = 0;
+
+  unsigned *sqTail, *sqMask, *sqArray;
+  unsigned *cqHead, *cqTail, *cqMask;
+  io_uring_cqe *cqes;
+
+  std::vector<Slot> slots;
+  std::vector<unsigned> freeSlots;
+
+  // Queue an SQE for whatever part of the slot's read is still missing
+  void queue(unsigned slotIndex) {
+    Slot &slot = slots[slotIndex];
+    std::size_t total = slot.request.count * 512;
+
+    slot.iov.iov_base = slot.request.buffer + slot.doneBytes;
+    slot.iov.iov_len = total - slot.doneBytes;
+
+    unsigned tail = *sqTail;
+    unsigned index = tail & *sqMask;
+
+    io_uring_sqe &sqe = sqes[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_READV;
+    sqe.fd = fd;
+    sqe.off = slot.request.firstSector * 512 + slot.doneBytes;
+    sqe.addr = (std::uint64_t)(std::uintptr_t)&slot.iov;
+    sqe.len = 1;
+    sqe.user_data = slotIndex;
+
+    sqArray[index] = index;
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    ++toSubmit;
+  }
+
+  int enter(unsigned submit, unsigned minComplete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, ringFd, submit, minComplete,
+                        flags, nullptr, 0);
+  }
+
+ public:
+  UringReadEngine(int fd, unsigned depth) : fd(fd), depth(depth) {}
+
+  ~UringReadEngine() override {
+    // The kernel may still write into caller buffers, let it finish first.
+    // This may run while a read error unwinds, so errors can't escape.
+    ReadCompletion completion;
+    if (ringFd >= 0) {
+      try {
+        while (wait(completion)) {
+        }
+      } catch (std::runtime_error &) {
+        // Closing the ring below cancels whatever is left
+      }
+    }
+
+    if (sqes != MAP_FAILED) munmap(sqes, sqesSize);
+    if (cqRing != MAP_FAILED && cqRing != sqRing) munmap(cqRing, cqRingSize);
+    if (sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+    if (ringFd >= 0) close(ringFd);
+  }
+
+  // False when io_uring is unavailable (old kernel, seccomp, ...)
+  bool setup() {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    ringFd = (int)syscall(__NR_io_uring_setup, depth, &params);
+    if (ringFd < 0) return false;
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+    bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap) sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED) return false;
+
+    if (singleMmap) {
+      cqRing = sqRing;
+    } else {
+      cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+      if (cqRing == MAP_FAILED) return false;
+    }
+
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = (io_uring_sqe *)mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_POPULATE, ringFd,
+                                IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) return false;
+
+    BYTE *sq = (BYTE *)sqRing;
+    sqTail = (unsigned *)(sq + params.sq_off.tail);
+    sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+    sqArray = (unsigned *)(sq + params.sq_off.array);
+
+    BYTE *cq = (BYTE *)cqRing;
+    cqHead = (unsigned *)(cq + params.cq_off.head);
+    cqTail = (unsigned *)(cq + params.cq_off.tail);
+    cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+    cqes = (io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    // Never more reads in flight than the SQ can hold
+    depth = std::min(depth, params.sq_entries);
+    slots.resize(depth);
+    for (unsigned i = depth; i > 0; --i) freeSlots.push_back(i - 1);
+
+    return true;
+  }
+
+  unsigned queueDepth() override { return depth; }
+  unsigned inFlight() override { return inFlightCount; }
+
+  void submit(const ReadRequest &request) override {
+    if (freeSlots.empty()) throw std::runtime_error("Read queue is full");
+
+    unsigned slotIndex = freeSlots.back();
+    freeSlots.pop_back();
+
+    slots[slotIndex].request = request;
+    slots[slotIndex].doneBytes = 0;
+    queue(slotIndex);
+    ++inFlightCount;
+  }
+
+  bool wait(ReadCompletion &completion) override {
+    while (inFlightCount > 0) {
+      unsigned head = *cqHead;
+      unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+
+      // Submit the whole batch and sleep until something comes back
+      if (head == tail || toSubmit > 0) {
+        int submitted =
+            enter(toSubmit, head == tail ? 1 : 0, IORING_ENTER_GETEVENTS);
+        if (submitted < 0) {
+          if (errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+          throw std::runtime_error("Unable to read");
+        }
+        toSubmit -= submitted;
+        continue;
+      }
+
+      io_uring_cqe cqe = cqes[head & *cqMask];
+      __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+
+      unsigned slotIndex = (unsigned)cqe.user_data;
+      Slot &slot = slots[slotIndex];
+
+      bool ok;
+      if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+        queue(slotIndex);
+        continue;
+      } else if (cqe.res <= 0) {
+        ok = false;  // error, or the end of the device
+      } else {
+        slot.doneBytes += cqe.res;
+        if (slot.doneBytes < slot.request.count * 512) {
+          queue(slotIndex);  // short read, fetch the rest
+          continue;
+        }
+        ok = true;
+      }
+
+      completion = {slot.request.tag, ok};
+      freeSlots.push_back(slotIndex);
+      --inFlightCount;
+      return true;
+    }
+
+    return false;
+  }
+};
+
+#endif
+
+}  // namespace
+
+std::unique_ptr<AsyncReadEngine> makeAsyncReadEngine(
+    std::shared_ptr<DeviceHandle> device, unsigned queueDepth) {
+  if (queueDepth == 0) queueDepth = 1;
+
+#ifdef FS_READER_IO_URING
+  if (int fd = device->descriptor(); fd >= 0) {
+    auto engine = std::make_unique<UringReadEngine>(fd, queueDepth);
+    if (engine->setup()) return engine;
+  }
+#endif
+
+  return std::make_unique<PoolReadEngine>(device, queueDepth);
+}
@@ -0,0 +1,120 @@
+#include "BlockCache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "Drive.hpp"
+#include "Global.hpp"
+
+BlockCache::BlockCache(Drive drive, int sectorsPerCluster,
+                       std::size_t byteBudget)
+    : drive(drive),
+      sectorsPerCluster(sectorsPerCluster),
+      byteBudget(byteBudget) {}
+
+void BlockCache::read(Index firstSector, Index count, BYTE *buffer) {
+  if (count == 0) return;
+
+  const std::size_t clusterBytes = (std::size_t)sectorsPerCluster * 512;
+  const Index firstCluster = firstSector / sectorsPerCluster;
+  const Index lastCluster = (firstSector + count - 1) / sectorsPerCluster;
+
+  // Copy the part of a cluster that overlaps the requested sectors
+  auto copyOut = [&](Index cluster, const BYTE *data) {
+    Index clusterStart = cluster * sectorsPerCluster;
+    Index from = std::max(clusterStart, firstSector);
+    Index to = std::min(clusterStart + sectorsPerCluster, firstSector + count);
+
+    std::memcpy(buffer + (from - firstSector) * 512,
+                data + (from - clusterStart) * 512, (to - from) * 512);
+  };
+
+  // --- Serve what we already have, remember the gaps ---
+  std::vector<Index> missing;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (Index cluster = firstCluster; cluster <= lastCluster; ++cluster) {
+      auto it = blocks.find(cluster);
+      if (it == blocks.end()) {
+        ++stats.misses;
+        missing.push_back(cluster);
+        continue;
+      }
+
+      ++stats.hits;
+      lru.splice(lru.begin(), lru, it->second);
+      copyOut(cluster, it->second->data.data());
+    }
+  }
+
+  if (missing.empty()) return;
+
+  // --- Fetch each contiguous gap with a single read ---
+  std::vector<BYTE> scratch;
+  for (std::size_t i = 0; i < missing.size();) {
+    std::size_t j = i + 1;
+    while (j < missing.size() && missing[j] == missing[j - 1] + 1) ++j;
+
+    Index runClusters = j - i;
+    scratch.resize(runClusters * clusterBytes);
+    drive.readRange(missing[i] * sectorsPerCluster,
+                    runClusters * sectorsPerCluster, scratch.data());
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (Index k = 0; k < runClusters; ++k) {
+      const BYTE *data = scratch.data() + k * clusterBytes;
+      copyOut(missing[i] + k, data);
+      insert(missing[i] + k, data);
+    }
+
+    i = j;
+  }
+}
+
+void BlockCache::insert(Index cluster, const BYTE *data) {
+  const std::size_t clusterBytes = (std::size_t)sectorsPerCluster * 512;
+
+  if (byteBudget < clusterBytes) return;
+  // Another reader may have fetched the same cluster in the meantime
+  if (blocks.find(cluster) != blocks.end()) return;
+
+  lru.push_front(Block{cluster, std::vector<BYTE>(data, data + clusterBytes)});
+  blocks[cluster] = lru.begin();
+  stats.bytesCached += clusterBytes;
+
+  evictToBudget();
+}
+
+void BlockCache::evictToBudget() {
+  while (stats.bytesCached > byteBudget && !lru.empty()) {
+    Block &victim = lru.back();
+
+    stats.bytesCached -= victim.data.size();
+    ++stats.evictions;
+    blocks.erase(victim.cluster);
+    lru.pop_back();
+  }
+}
+
+void BlockCache::setByteBudget(std::size_t byteBudget) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  this->byteBudget = byteBudget;
+  evictToBudget();
+}
+
+void BlockCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  lru.clear();
+  blocks.clear();
+  stats.bytesCached = 0;
+}
+
+BlockCacheStats BlockCache::getStats() {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  return stats;
+}
@@ -0,0 +1,148 @@
+#include "DirectoryIndex.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include "Global.hpp"
+
+using namespace Ntfs;
+
+void DirectoryIndex::grow(Index id) {
+  if (id < flags.size()) return;
+
+  parents.resize(id + 1, (RecordId)NoParent);
+  flags.resize(id + 1, 0);
+  nameHandles.resize(id + 1);
+}
+
+void DirectoryIndex::clear() {
+  parents.clear();
+  flags.clear();
+  nameHandles.clear();
+  names.clear();
+  childStart.clear();
+  childList.clear();
+  streamList.clear();
+  finalized = false;
+}
+
+void DirectoryIndex::reserve(Index records, std::size_t nameUnits) {
+  parents.reserve(records);
+  flags.reserve(records);
+  nameHandles.reserve(records);
+  names.reserve(nameUnits);
+}
+
+void DirectoryIndex::add(Index id, Index parent, bool isDirectory,
+                         const BYTE *name, BYTE nameLength) {
+  if (parent > NoParent) parent = NoParent;
+
+  grow(id);
+
+  flags[id] = Present | (isDirectory ? Directory : 0);
+  parents[id] = (RecordId)parent;
+
+  nameHandles[id] = names.add(name, nameLength);
+
+  if (parent != NoParent) {
+    grow(parent);
+    if (!(flags[parent] & Present)) flags[parent] = Present | Directory;
+  }
+
+  finalized = false;
+}
+
+void DirectoryIndex::addStream(Index id, const BYTE *name, BYTE nameLength,
+                               QWORD size) {
+  Stream stream;
+  stream.record = (RecordId)id;
+  stream.name = names.add(name, nameLength);
+  stream.size = size;
+  streamList.push_back(stream);
+
+  finalized = false;
+}
+
+void DirectoryIndex::finalize() {
+  const Index count = flags.size();
+
+  // --- Count children per parent ---
+  childStart.assign(count + 1, 0);
+  for (Index id = 0; id < count; ++id) {
+    Index parent = parents[id];
+    // The root directory is its own parent
+    if (!(flags[id] & Present) || parent == NoParent || parent == id) continue;
+
+    ++childStart[parent + 1];
+  }
+
+  for (Index id = 0; id < count; ++id) childStart[id + 1] += childStart[id];
+
+  // --- Place them, walking records in order ---
+  childList.resize(childStart[count]);
+  std::vector<std::uint32_t> fill(childStart.begin(), childStart.end() - 1);
+  for (Index id = 0; id < count; ++id) {
+    Index parent = parents[id];
+    if (!(flags[id] & Present) || parent == NoParent || parent == id) continue;
+
+    childList[fill[parent]++] = (RecordId)id;
+  }
+
+  // Streams found in extension records may come after their base's
+  std::stable_sort(streamList.begin(), streamList.end(),
+                   [](const Stream &a, const Stream &b) {
+                     return a.record < b.record;
+                   });
+
+  finalized = true;
+}
+
+Index DirectoryIndex::size() const { return flags.size(); }
+
+bool DirectoryIndex::contains(Index id) const {
+  return id < flags.size() && (flags[id] & Present);
+}
+
+bool DirectoryIndex::isDirectory(Index id) const {
+  return id < flags.size() && (flags[id] & Directory);
+}
+
+Index DirectoryIndex::getParent(Index id) const {
+  if (!contains(id)) return NoParent;
+
+  return parents[id];
+}
+
+std::u16string_view DirectoryIndex::getName(Index id) const {
+  if (!contains(id)) return {};
+
+  return names.get(nameHandles[id]);
+}
+
+DirectoryIndex::ChildRange DirectoryIndex::children(Index id) const {
+  ChildRange range;
+  if (!finalized || id >= flags.size()) return range;
+
+  range.first = childList.data() + childStart[id];
+  range.last = childList.data() + childStart[id + 1];
+  return range;
+}
+
+DirectoryIndex::StreamRange DirectoryIndex::streams(Index id) const {
+  StreamRange range;
+  if (!finalized) return range;
+
+  auto first = std::lower_bound(
+      streamList.begin(), streamList.end(), id,
+      [](const Stream &stream, Index id) { return stream.record < id; });
+  auto last = first;
+  while (last != streamList.end() && last->record == id) ++last;
+
+  range.first = streamList.data() + (first - streamList.begin());
+  range.last = streamList.data() + (last - streamList.begin());
+  return range;
+}
+
+std::u16string_view DirectoryIndex::getStreamName(const Stream &stream) const {
+  return names.get(stream.name);
+}
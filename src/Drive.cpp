@@ -7,18 +7,206 @@
 #include <stdexcept>
 #include <string>
 
+#include "AsyncIo.hpp"
 #include "Utils.hpp"
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#endif
+
+#include <cstring>
+
 using std::string;
 
+const BYTE *DeviceHandle::view(Index /*offset*/, std::size_t /*length*/) {
+  return nullptr;
+}
+
+int DeviceHandle::descriptor() { return -1; }
+
+// --- FileDevice ---
+
+#ifdef _WIN32
+FileDevice::FileDevice(const string &path) {
+  handle = CreateFileA(path.c_str(),                        // Drive to open
+                       GENERIC_READ,                        // Access mode
+                       FILE_SHARE_READ | FILE_SHARE_WRITE,  // Share Mode
+                       NULL,           // Security Descriptor
+                       OPEN_EXISTING,  // How to create
+                       0,              // File attributes
+                       NULL);          // Handle to template
+
+  if (handle == INVALID_HANDLE_VALUE) {
+    throw std::runtime_error("Unable to access");
+  }
+}
+
+FileDevice::~FileDevice() { CloseHandle(handle); }
+
+void FileDevice::readAt(Index offset, BYTE *buffer, std::size_t length) {
+  while (length > 0) {
+    // The offset travels with the request instead of through the shared file
+    // pointer, so concurrent reads on the same handle don't race
+    OVERLAPPED overlapped = {};
+    overlapped.Offset = (DWORD)(offset & 0xFFFFFFFF);
+    overlapped.OffsetHigh = (DWORD)(offset >> 32);
+
+    DWORD toRead = length > 0x40000000 ? 0x40000000 : (DWORD)length;
+    DWORD bytesRead = 0;
+    if (!ReadFile(handle, buffer, toRead, &bytesRead, &overlapped)) {
+      if (GetLastError() == ERROR_HANDLE_EOF) {
+        throw std::runtime_error("Reach the end of the file");
+      }
+      throw std::runtime_error("Unable to read");
+    }
+    if (bytesRead == 0) throw std::runtime_error("Reach the end of the file");
+
+    offset += bytesRead;
+    buffer += bytesRead;
+    length -= bytesRead;
+  }
+}
+#else
+FileDevice::FileDevice(const string &path) {
+  fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+  if (fd < 0) throw std::runtime_error("Unable to access");
+}
+
+FileDevice::~FileDevice() { close(fd); }
+
+int FileDevice::descriptor() { return fd; }
+
+void FileDevice::readAt(Index offset, BYTE *buffer, std::size_t length) {
+  while (length > 0) {
+    ssize_t bytesRead = pread(fd, buffer, length, (off_t)offset);
+
+    if (bytesRead < 0) {
+      if (errno == EINTR) continue;
+      throw std::runtime_error("Unable to read");
+    }
+    if (bytesRead == 0) throw std::runtime_error("Reach the end of the file");
+
+    offset += bytesRead;
+    buffer += bytesRead;
+    length -= bytesRead;
+  }
+}
+#endif
+
+// --- MappedDevice ---
+
+#ifdef _WIN32
+MappedDevice::MappedDevice(const string &path) {
+  handle = CreateFileA(path.c_str(), GENERIC_READ,
+                       FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL, NULL);
+  if (handle == INVALID_HANDLE_VALUE) {
+    throw std::runtime_error("Unable to access");
+  }
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0) {
+    CloseHandle(handle);
+    throw std::runtime_error("Unable to map");
+  }
+  size = fileSize.QuadPart;
+
+  mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (mapping == NULL) {
+    CloseHandle(handle);
+    throw std::runtime_error("Unable to map");
+  }
+
+  base = (const BYTE *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (base == NULL) {
+    CloseHandle(mapping);
+    CloseHandle(handle);
+    throw std::runtime_error("Unable to map");
+  }
+}
+
+MappedDevice::~MappedDevice() {
+  UnmapViewOfFile(base);
+  CloseHandle(mapping);
+  CloseHandle(handle);
+}
+#else
+MappedDevice::MappedDevice(const string &path) {
+  fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) throw std::runtime_error("Unable to access");
+
+  // st_size is 0 for block devices, ask for their end instead
+  struct stat info;
+  if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+    size = info.st_size;
+  } else {
+    off_t end = lseek(fd, 0, SEEK_END);
+    size = end > 0 ? end : 0;
+  }
+
+  void *addr = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0)
+                        : MAP_FAILED;
+  if (addr == MAP_FAILED) {
+    close(fd);
+    throw std::runtime_error("Unable to map");
+  }
+
+  base = (const BYTE *)addr;
+}
+
+MappedDevice::~MappedDevice() {
+  munmap((void *)base, size);
+  close(fd);
+}
+#endif
+
+void MappedDevice::readAt(Index offset, BYTE *buffer, std::size_t length) {
+  const BYTE *source = view(offset, length);
+  if (!source) throw std::runtime_error("Reach the end of the file");
+
+  std::memcpy(buffer, source, length);
+}
+
+const BYTE *MappedDevice::view(Index offset, std::size_t length) {
+  if (offset > size || length > size - offset) return nullptr;
+
+  return base + offset;
+}
+
+// --- Drive ---
+
 void Drive::configure(string drive) {
-  if (Utils::getOSName() == Utils::OS::Windows) {
+  if (Utils::getOSName() == Utils::OS::Windows && drive.size() == 1) {
     std::stringstream builder;
     builder << R"(\\.\)" << drive << R"(:)";
 
     this->driveAccess = builder.str();
 
+    this->name = drive + ":";
+
+    // Keep one handle open for the lifetime of the drive instead of
+    // reopening the device on every sector read
+    this->device = std::make_shared<FileDevice>(this->driveAccess);
+  } else {
+    // Disk image or block device
+    this->driveAccess = drive;
+
     this->name = drive;
+
+    try {
+      this->device = std::make_shared<MappedDevice>(this->driveAccess);
+    } catch (std::runtime_error &) {
+      // Mapping can fail where opening doesn't (e.g. no address space left)
+      this->device = std::make_shared<FileDevice>(this->driveAccess);
+    }
   }
 
   Sector sector;
@@ -34,15 +222,30 @@ void Drive::configure(string drive) {
 }
 
 void Drive::readSector(Index readPoint, Sector &sector) {
-  std::ifstream driveStream(this->driveAccess, std::ios::binary);
-
-  if (!driveStream) throw std::runtime_error("Unable to access");
+  if (!device) throw std::runtime_error("Unable to access");
 
   Index offset = readPoint * 512;
-  if (!driveStream.seekg(offset, std::ios::beg)) {
-    throw std::runtime_error("Reach the end of the file");
-  }
-  driveStream.read((char *)sector.data(), sector.size());
+  device->readAt(offset, sector.data(), sector.size());
+}
+
+void Drive::readRange(Index firstSector, Index count, BYTE *buffer) {
+  if (!device) throw std::runtime_error("Unable to access");
+
+  Index offset = firstSector * 512;
+  device->readAt(offset, buffer, count * 512);
+}
+
+const BYTE *Drive::viewRange(Index firstSector, Index count) {
+  if (!device) throw std::runtime_error("Unable to access");
+
+  return device->view(firstSector * 512, count * 512);
+}
+
+std::unique_ptr<AsyncReadEngine> Drive::createAsyncEngine(
+    unsigned queueDepth) {
+  if (!device) throw std::runtime_error("Unable to access");
+
+  return makeAsyncReadEngine(device, queueDepth);
 }
 
 void Drive::readSector(Index readPoint, std::ifstream& ifs) {
@@ -56,4 +259,4 @@ void Drive::readSector(Index readPoint, std::ifstream& ifs) {
 
 FileSystem Drive::getFileSystem() { return this->fileSytem; }
 
-std::string Drive::getName() { return this->name + ":"; }
\ No newline at end of file
+std::string Drive::getName() { return this->name; }
\ No newline at end of file
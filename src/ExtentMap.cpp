@@ -0,0 +1,54 @@
+#include "ExtentMap.hpp"
+
+#include <algorithm>
+
+using namespace Ntfs;
+
+void ExtentMap::clear() {
+  vcnStarts.assign(1, 0);
+  lcns.clear();
+  runCluster = 0;
+}
+
+void ExtentMap::add(const DataRun &run) {
+  if (run.clusterCount == 0) return;
+
+  QWORD lcn = Sparse;
+  if (!run.sparse) {
+    runCluster += run.firstCluster;
+    lcn = runCluster;
+  }
+
+  // Carries on the last extent, on disk or as a hole
+  if (!lcns.empty()) {
+    QWORD lastLcn = lcns.back();
+    QWORD lastCount = vcnStarts.back() - vcnStarts[vcnStarts.size() - 2];
+
+    if (lcn == Sparse ? lastLcn == Sparse
+                      : lastLcn != Sparse && lastLcn + lastCount == lcn) {
+      vcnStarts.back() += run.clusterCount;
+      return;
+    }
+  }
+
+  lcns.push_back(lcn);
+  vcnStarts.push_back(vcnStarts.back() + run.clusterCount);
+}
+
+ExtentMap::Extent ExtentMap::operator[](std::size_t i) const {
+  return {vcnStarts[i], lcns[i], vcnStarts[i + 1] - vcnStarts[i]};
+}
+
+ExtentMap::Extent ExtentMap::find(QWORD vcn) const {
+  if (vcn >= clusterCount()) return {vcn, Sparse, 0};
+
+  // Last start at or before vcn
+  std::size_t i =
+      std::upper_bound(vcnStarts.begin(), vcnStarts.end(), vcn) -
+      vcnStarts.begin() - 1;
+
+  QWORD skipped = vcn - vcnStarts[i];
+  QWORD lcn = lcns[i] == Sparse ? Sparse : lcns[i] + skipped;
+
+  return {vcn, lcn, vcnStarts[i + 1] - vcn};
+}
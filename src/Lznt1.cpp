@@ -0,0 +1,93 @@
+#include "Lznt1.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "Global.hpp"
+
+using namespace Ntfs;
+
+std::size_t Ntfs::decompressLznt1(const BYTE *in, std::size_t inLength,
+                                  BYTE *out, std::size_t outLength) {
+  // The stream is a list of chunks, each worth 4 KiB of output
+  const std::size_t chunkBytes = 4096;
+  const BYTE *inEnd = in + inLength;
+  std::size_t written = 0;
+
+  while (inEnd - in >= 2 && written < outLength) {
+    WORD header = in[0] | in[1] << 8;
+    if (header == 0) break;  // no more chunks in the unit
+
+    std::size_t size = (header & 0xFFF) + 1;
+    const BYTE *chunk = in + 2;
+    if ((std::size_t)(inEnd - chunk) < size) {
+      throw std::runtime_error("Compressed data is corrupt");
+    }
+    const BYTE *chunkEnd = chunk + size;
+    in = chunkEnd;
+
+    // --- Stored as is ---
+    if (!(header & 0x8000)) {
+      std::size_t n = std::min(size, outLength - written);
+      std::memcpy(out + written, chunk, n);
+      written += n;
+      continue;
+    }
+
+    // --- Compressed: groups of 8 tokens, each a literal or a back reference
+    // tagged by one bit of the byte before them ---
+    BYTE *chunkOut = out + written;
+    std::size_t chunkLimit = std::min(chunkBytes, outLength - written);
+    std::size_t pos = 0;
+
+    while (chunk < chunkEnd) {
+      BYTE tags = *chunk++;
+
+      for (int bit = 0; bit < 8 && chunk < chunkEnd; ++bit, tags >>= 1) {
+        if (!(tags & 1)) {
+          if (pos == chunkLimit) {
+            throw std::runtime_error("Compressed data is corrupt");
+          }
+          chunkOut[pos++] = *chunk++;
+          continue;
+        }
+
+        if (chunkEnd - chunk < 2 || pos == 0) {
+          throw std::runtime_error("Compressed data is corrupt");
+        }
+        WORD token = chunk[0] | chunk[1] << 8;
+        chunk += 2;
+
+        // The further into the chunk, the more of the token is offset
+        unsigned lengthBits = 12;
+        for (std::size_t i = pos - 1; i >= 0x10; i >>= 1) --lengthBits;
+
+        std::size_t offset = (token >> lengthBits) + 1;
+        std::size_t length = (token & ((1u << lengthBits) - 1)) + 3;
+        if (offset > pos || length > chunkLimit - pos) {
+          throw std::runtime_error("Compressed data is corrupt");
+        }
+
+        // An overlapping reference repeats the bytes it is producing
+        BYTE *to = chunkOut + pos;
+        const BYTE *from = to - offset;
+        if (offset >= length) {
+          std::memcpy(to, from, length);
+        } else {
+          for (std::size_t i = 0; i < length; ++i) to[i] = from[i];
+        }
+        pos += length;
+      }
+    }
+
+    // A chunk that decompresses short ends in zeros, unless it's the last one
+    if (pos < chunkLimit && inEnd - in >= 2 && (in[0] | in[1]) != 0) {
+      std::memset(chunkOut + pos, 0, chunkLimit - pos);
+      pos = chunkLimit;
+    }
+    written += pos;
+  }
+
+  return written;
+}
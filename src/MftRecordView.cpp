@@ -0,0 +1,338 @@
+#include "MftRecordView.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Global.hpp"
+#include "Utils.hpp"
+
+using namespace Ntfs;
+
+// --- Update sequence ---
+
+FixupResult Ntfs::applyFixup(BYTE *block, std::size_t size) {
+  const std::size_t stride = 512;
+
+  if (size < stride) return FixupResult::Invalid;
+
+  WORD usaOffset = Utils::readLittleEndianVal<WORD>(block, 0x4);
+  WORD usaCount = Utils::readLittleEndianVal<WORD>(block, 0x6);
+
+  // One entry for the sequence number, then one per stride. The array has to
+  // sit before the first stride's tail, or fixing up would overwrite it.
+  std::size_t strides = usaCount - 1;
+  if (usaCount < 2 || strides * stride > size ||
+      (std::size_t)usaOffset + usaCount * 2 > stride - 2) {
+    return FixupResult::Invalid;
+  }
+
+  const BYTE *usa = block + usaOffset;
+  WORD usn;
+  std::memcpy(&usn, usa, 2);
+
+  // Check and restore in the same pass, without branching per stride
+  WORD mismatch = 0;
+  for (std::size_t i = 0; i < strides; ++i) {
+    BYTE *tail = block + (i + 1) * stride - 2;
+
+    WORD stored;
+    std::memcpy(&stored, tail, 2);
+    mismatch |= stored ^ usn;
+    std::memcpy(tail, usa + (i + 1) * 2, 2);
+  }
+
+  return mismatch ? FixupResult::Torn : FixupResult::Ok;
+}
+
+// --- Data runs ---
+
+std::size_t Ntfs::decodeDataRuns(const BYTE *&pos, const BYTE *limit,
+                                 DataRun *runs, std::size_t capacity) {
+  std::size_t count = 0;
+
+  while (pos != nullptr && count < capacity) {
+    // A zero header byte ends the list, anything running past the attribute
+    // means the list is corrupt
+    BYTE header = pos < limit ? *pos : 0;
+    unsigned lengthSize = header & 0xF;
+    unsigned offsetSize = header >> 4;
+    const BYTE *end = pos + 1 + lengthSize + offsetSize;
+
+    if (header == 0 || lengthSize > 8 || offsetSize > 8 || end > limit) {
+      pos = nullptr;
+      break;
+    }
+
+    // Both fields are at most 8 bytes, so they are loaded a word at a time and
+    // the bytes past them masked off. Only close to the end of the attribute,
+    // where a whole word could run past it, do the bytes go through a copy.
+    const BYTE *fields = pos + 1;
+    BYTE tail[16] = {0};
+    if (limit - fields < 16) {
+      std::memcpy(tail, fields, end - fields);
+      fields = tail;
+    }
+
+    QWORD length, offset;
+    std::memcpy(&length, fields, 8);
+    std::memcpy(&offset, fields + lengthSize, 8);
+
+    unsigned lengthShift = 64 - 8 * lengthSize;
+    unsigned offsetShift = 64 - 8 * offsetSize;
+    DataRun &run = runs[count++];
+
+    run.clusterCount = lengthSize ? (length << lengthShift) >> lengthShift : 0;
+    // Sign extended: the top bit of the last byte stored tells the direction
+    run.firstCluster =
+        offsetSize ? (std::int64_t)(offset << offsetShift) >> offsetShift : 0;
+    // No offset at all marks a hole
+    run.sparse = offsetSize == 0;
+
+    pos = end;
+  }
+
+  return count;
+}
+
+DataRunIterator::DataRunIterator(const BYTE *runList, const BYTE *limit)
+    : next(runList), limit(limit) {
+  decode();
+}
+
+void DataRunIterator::decode() {
+  pos = next;
+  if (decodeDataRuns(next, limit, &run, 1) == 0) pos = nullptr;
+}
+
+DataRunIterator &DataRunIterator::operator++() {
+  decode();
+
+  return *this;
+}
+
+// --- Attributes ---
+
+DWORD AttributeView::type() const {
+  return Utils::readLittleEndianVal<DWORD>(attr, 0x0);
+}
+
+DWORD AttributeView::length() const {
+  return Utils::readLittleEndianVal<DWORD>(attr, 0x4);
+}
+
+bool AttributeView::isNonResident() const {
+  return Utils::readLittleEndianVal<BYTE>(attr, 0x8) != 0;
+}
+
+BYTE AttributeView::nameLength() const {
+  return Utils::readLittleEndianVal<BYTE>(attr, 0x9);
+}
+
+const BYTE *AttributeView::name() const {
+  return attr + Utils::readLittleEndianVal<WORD>(attr, 0xA);
+}
+
+DWORD AttributeView::valueLength() const {
+  if (isNonResident()) return 0;
+
+  return Utils::readLittleEndianVal<DWORD>(attr, 0x10);
+}
+
+const BYTE *AttributeView::value() const {
+  if (isNonResident()) return nullptr;
+
+  WORD valueOffset = Utils::readLittleEndianVal<WORD>(attr, 0x14);
+  if ((QWORD)valueOffset + valueLength() > length()) return nullptr;
+
+  return attr + valueOffset;
+}
+
+QWORD AttributeView::lowestVcn() const {
+  if (!isNonResident()) return 0;
+
+  return Utils::readLittleEndianVal<QWORD>(attr, 0x10);
+}
+
+QWORD AttributeView::allocatedSize() const {
+  if (!isNonResident()) return 0;
+
+  return Utils::readLittleEndianVal<QWORD>(attr, 0x28);
+}
+
+QWORD AttributeView::realSize() const {
+  if (!isNonResident()) return valueLength();
+
+  return Utils::readLittleEndianVal<QWORD>(attr, 0x30);
+}
+
+const BYTE *AttributeView::runList() const {
+  if (!isNonResident()) return nullptr;
+
+  WORD runListOffset = Utils::readLittleEndianVal<WORD>(attr, 0x20);
+  if (runListOffset >= length()) return nullptr;
+
+  return attr + runListOffset;
+}
+
+DataRunRange AttributeView::dataRuns() const {
+  const BYTE *runs = runList();
+  if (runs == nullptr) return {};
+
+  return {DataRunIterator(runs, attr + length()), {}};
+}
+
+AttributeIterator::AttributeIterator(const BYTE *record, std::size_t offset,
+                                     std::size_t limit)
+    : record(record), offset(offset), limit(limit) {
+  check();
+}
+
+void AttributeIterator::check() {
+  if (offset == End) return;
+
+  if (offset + 0x8 > limit) {
+    offset = End;
+    return;
+  }
+
+  DWORD attrTypeID = Utils::readLittleEndianVal<DWORD>(record, offset);
+  DWORD attrLength = Utils::readLittleEndianVal<DWORD>(record, offset + 0x4);
+
+  // The smallest attribute is a resident header with an empty value
+  if (attrTypeID == 0xFFFFFFFF || attrLength < 0x18 ||
+      offset + attrLength > limit) {
+    offset = End;
+  }
+}
+
+AttributeIterator &AttributeIterator::operator++() {
+  offset += Utils::readLittleEndianVal<DWORD>(record, offset + 0x4);
+  check();
+
+  return *this;
+}
+
+// --- Attribute values ---
+
+Index FileNameView::parent() const {
+  return Utils::readLittleEndianVal(value, 0x0, 6);
+}
+
+DWORD FileNameView::flags() const {
+  return Utils::readLittleEndianVal<DWORD>(value, 0x38);
+}
+
+BYTE FileNameView::nameLength() const {
+  return Utils::readLittleEndianVal<BYTE>(value, 0x40);
+}
+
+BYTE FileNameView::nameNamespace() const {
+  return Utils::readLittleEndianVal<BYTE>(value, 0x41);
+}
+
+const BYTE *FileNameView::name() const { return value + 0x42; }
+
+QWORD StandardInfoView::createdTime() const {
+  return Utils::readLittleEndianVal<QWORD>(value, 0x0);
+}
+
+QWORD StandardInfoView::modifiedTime() const {
+  return Utils::readLittleEndianVal<QWORD>(value, 0x8);
+}
+
+QWORD StandardInfoView::mftModifiedTime() const {
+  return Utils::readLittleEndianVal<QWORD>(value, 0x10);
+}
+
+QWORD StandardInfoView::accessedTime() const {
+  return Utils::readLittleEndianVal<QWORD>(value, 0x18);
+}
+
+DWORD StandardInfoView::flags() const {
+  return Utils::readLittleEndianVal<DWORD>(value, 0x20);
+}
+
+// --- Record ---
+
+MftRecordView::MftRecordView(const BYTE *record, std::size_t size)
+    : record(record), size(size) {}
+
+bool MftRecordView::isValid() const {
+  if (record == nullptr || size < 0x30) return false;
+  if (std::memcmp(record, "FILE", 4) != 0) return false;
+
+  WORD firstAttrOffset = Utils::readLittleEndianVal<WORD>(record, 0x14);
+  return firstAttrOffset < size;
+}
+
+bool MftRecordView::isInUse() const {
+  return Utils::readLittleEndianVal<WORD>(record, 0x16) & 1;
+}
+
+bool MftRecordView::isDirectory() const {
+  return Utils::readLittleEndianVal<WORD>(record, 0x16) & (1 << 1);
+}
+
+DWORD MftRecordView::recordNumber() const {
+  return Utils::readLittleEndianVal<DWORD>(record, 0x2C);
+}
+
+Index MftRecordView::baseRecord() const {
+  return Utils::readLittleEndianVal(record, 0x20, 6);
+}
+
+AttributeRange MftRecordView::attributes() const {
+  if (!isValid()) return {};
+
+  DWORD usedSize = Utils::readLittleEndianVal<DWORD>(record, 0x18);
+  WORD firstAttrOffset = Utils::readLittleEndianVal<WORD>(record, 0x14);
+
+  std::size_t limit = std::min<std::size_t>(usedSize, size);
+  return {AttributeIterator(record, firstAttrOffset, limit), {}};
+}
+
+AttributeView MftRecordView::find(DWORD type) const {
+  for (AttributeView attr : attributes()) {
+    if (attr.type() == type) return attr;
+  }
+
+  return {};
+}
+
+FileNameView MftRecordView::fileName() const {
+  FileNameView dosName;
+
+  for (AttributeView attr : attributes()) {
+    if (attr.type() != 0x30 || attr.isNonResident()) continue;
+
+    const BYTE *value = attr.value();
+    if (value == nullptr || attr.valueLength() < 0x42) continue;
+
+    FileNameView name(value);
+    if (0x42 + name.nameLength() * 2u > attr.valueLength()) continue;
+
+    // A DOS 8.3 name comes along with the long one, prefer the latter
+    if (name.nameNamespace() != 2) return name;
+    if (!dosName.isValid()) dosName = name;
+  }
+
+  return dosName;
+}
+
+StandardInfoView MftRecordView::standardInfo() const {
+  AttributeView attr = find(0x10);
+  if (!attr.isValid() || attr.isNonResident()) return {};
+
+  const BYTE *value = attr.value();
+  if (value == nullptr || attr.valueLength() < 0x24) return {};
+
+  return StandardInfoView(value);
+}
+
+DataRunRange MftRecordView::dataRuns() const {
+  for (AttributeView attr : attributes()) {
+    if (attr.type() == 0x80 && attr.nameLength() == 0) return attr.dataRuns();
+  }
+
+  return {};
+}
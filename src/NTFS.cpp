@@ -1,18 +1,38 @@
 #include "NTFS.hpp"
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstring>
+#include <deque>
+#include <exception>
 #include <fstream>
 #include <iostream>
 #include <iterator>
 #include <map>
 #include <stdexcept>
-#include <unordered_map>
+#include <thread>
+#include <unordered_set>
 
+#include "AsyncIo.hpp"
+#include "BoundedQueue.hpp"
+#include "DirectoryIndex.hpp"
 #include "Drive.hpp"
+#include "ExtentMap.hpp"
 #include "Global.hpp"
+#include "Lznt1.hpp"
+#include "MftRecordView.hpp"
+#include "ThreadPool.hpp"
 #include "Utils.hpp"
 
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+
+#include <cerrno>
+#endif
+
 using namespace Ntfs;
 
 void Reader::read(Drive drive) {
@@ -52,13 +72,26 @@ void Reader::read(Drive drive) {
   };
 
   // Calculate entry size
-  if (pbs.bpb.BytesPerFileRecordSegment.first = true) {
+  if (pbs.bpb.BytesPerFileRecordSegment.first == true) {
     entrySize = (pbs.bpb.BytesPerFileRecordSegment.second / 512);
   } else {
     entrySize =
         pbs.bpb.clustersPerFileRecordSegment * pbs.bpb.sectorsPerCluster;
   }
 
+  // Drop whatever was cached from the previous read
+  cache = std::make_shared<BlockCache>(drive, pbs.bpb.sectorsPerCluster,
+                                       cacheBudget);
+
+  // $MFT:$BITMAP and the extents are loaded again on the next scan
+  mftBitmap.clear();
+  bitmapLoaded = false;
+  mftExtents.clear();
+  mftRecordCount = 0;
+
+  // The engine reads from the previous drive
+  readEngine.reset();
+
   hasRead = true;
 }
 
@@ -70,6 +103,19 @@ void Reader::refresh() {
   }
 }
 
+void Reader::setCacheBudget(std::size_t bytes) {
+  cacheBudget = bytes;
+  if (cache) cache->setByteBudget(bytes);
+}
+
+BlockCacheStats Reader::getCacheStats() {
+  if (!hasRead) {
+    throw std::runtime_error("No drive has been read");
+  }
+
+  return cache->getStats();
+}
+
 PBS Reader::getPbs() {
   if (!hasRead) {
     throw std::runtime_error("No drive has been read");
@@ -78,77 +124,89 @@ PBS Reader::getPbs() {
   return pbs;
 }
 
-MftEntryAvailability Reader::readMftEntry(Index sectorNum, MftEntry &entry) {
+FixupResult Reader::loadEntry(Index sectorNum, BYTE *buffer) {
+  // Even a mapped record is copied out, the fixup has to write to it
+  if (const BYTE *mapped = curDrive.viewRange(sectorNum, entrySize)) {
+    std::memcpy(buffer, mapped, entrySize * 512);
+  } else {
+    cache->read(sectorNum, entrySize, buffer);
+  }
+
+  return applyFixup(buffer, entrySize * 512);
+}
+
+MftEntryAvailability Reader::readMftEntry(Index sectorNum, MftEntry &entry,
+                                          Arena *arena) {
   if (!hasRead) {
     throw std::runtime_error("No drive has been read");
   }
 
-  // --- Get the whole entry ---
-  std::vector<BYTE> entryRaw;
+  ArenaAllocator<BYTE> allocator(arena);
 
-  entryRaw.reserve(entrySize);
+  // --- Get the whole entry, kept in it for resident content ---
+  const std::size_t recordBytes = entrySize * 512;
+  entry.records = ArenaVector<BYTE>(recordBytes, allocator);
+  BYTE *entryRaw = entry.records.data();
 
-  bool isInvalidEntry = false;
-  for (int i = 0; i < entrySize; ++i) {
-    Sector sector;
-    curDrive.readSector(sectorNum + i, sector);
+  // A torn record mixes sectors from two writes, nothing in it can be trusted
+  if (loadEntry(sectorNum, entryRaw) == FixupResult::Torn) {
+    return MftEntryAvailability::Invalid;
+  }
 
-    if (i == 0) {
-      // Check if this is an actual entry/record
-      std::string signature = Utils::readString(sector, 0, sizeof(DWORD));
-      if (signature != "FILE") {
-        isInvalidEntry = true;
-        break;
-      }
-    }
+  entry.stdInfoAttr.header.name = ArenaString(allocator);
+  entry.fileNameAttr.header.name = ArenaString(allocator);
+  entry.fileNameAttr.fileName = ArenaVector<BYTE>(allocator);
+  entry.dataAttrs = ArenaVector<DataAttribute>(allocator);
 
-    entryRaw.insert(entryRaw.end(), sector.begin(), sector.end());
-  }
+  MftRecordView record(entryRaw, recordBytes);
 
-  if (isInvalidEntry) return MftEntryAvailability::Invalid;
+  // Check if this is an actual entry/record
+  if (!record.isValid()) return MftEntryAvailability::Invalid;
 
   // --- Read Entry header ---
-  entry.header.id = Utils::readLittleEndianVal<DWORD>(entryRaw, 0x2C);
+  entry.header.id = record.recordNumber();
 
-  WORD flags = Utils::readLittleEndianVal<WORD>(entryRaw, 0x16);
-  if (flags & 1)
+  if (record.isInUse())
     entry.header.isInUse = true;
   else
     return MftEntryAvailability::NotInUse;  // No purpose of continue reading
-  if (flags & (1 << 1)) entry.header.isDirectory = true;
+  if (record.isDirectory()) entry.header.isDirectory = true;
+
+  std::vector<AttributeView> attrs;
+  std::vector<BYTE> extensions;
+  collectAttributes(record, extensions, attrs);
 
-  WORD firstAttrOffset = Utils::readLittleEndianVal<WORD>(entryRaw, 0x14);
+  // Where bytes end up in entry.records once the extensions follow the record
+  auto recordsOffset = [&](const BYTE *pos) -> DWORD {
+    if (pos >= entryRaw && pos < entryRaw + recordBytes) return pos - entryRaw;
+    return recordBytes + (pos - extensions.data());
+  };
 
   // --- Read Entry's attributes ---
+  const BYTE *attrRaw = nullptr;
   auto readAttrHeader = [&](DWORD &attrLength, BYTE &nameLength,
                             WORD &dataOffset,
                             AttributeHeader &attrHeader) -> void {
-    attrLength =
-        Utils::readLittleEndianVal<DWORD>(entryRaw, firstAttrOffset + 0x4);
+    attrLength = Utils::readLittleEndianVal<DWORD>(attrRaw, 0x4);
 
-    nameLength =
-        Utils::readLittleEndianVal<BYTE>(entryRaw, firstAttrOffset + 0x9);
+    nameLength = Utils::readLittleEndianVal<BYTE>(attrRaw, 0x9);
     if (nameLength != 0) {
-      WORD nameOffset =
-          Utils::readLittleEndianVal<WORD>(entryRaw, firstAttrOffset + 0x10);
-      attrHeader.name =
-          Utils::readString(entryRaw, firstAttrOffset + nameOffset, nameLength);
+      WORD nameOffset = Utils::readLittleEndianVal<WORD>(attrRaw, 0xA);
+      const BYTE *name = attrRaw + nameOffset;
+      attrHeader.name.assign(name, name + nameLength * 2);
     }
 
-    if (Utils::readLittleEndianVal<BYTE>(entryRaw, firstAttrOffset + 0x8) !=
-        0) {
+    if (Utils::readLittleEndianVal<BYTE>(attrRaw, 0x8) != 0) {
       attrHeader.isNonResident = true;
-      dataOffset =
-          Utils::readLittleEndianVal<WORD>(entryRaw, firstAttrOffset + 0x20);
+      dataOffset = Utils::readLittleEndianVal<WORD>(attrRaw, 0x20);
     } else {
-      dataOffset =
-          Utils::readLittleEndianVal<WORD>(entryRaw, firstAttrOffset + 0x14);
+      dataOffset = Utils::readLittleEndianVal<WORD>(attrRaw, 0x14);
     }
   };
 
-  while (firstAttrOffset < 512 - sizeof(DWORD)) {
-    DWORD attrTypeID =
-        Utils::readLittleEndianVal<DWORD>(entryRaw, firstAttrOffset);
+  for (AttributeView attr : attrs) {
+    attrRaw = attr.data();
+    DWORD attrTypeID = attr.type();
 
     if (attrTypeID == 0x10) {  // $STANDARD_INFORMATION
 
@@ -161,13 +219,10 @@ MftEntryAvailability Reader::readMftEntry(Index sectorNum, MftEntry &entry) {
       readAttrHeader(attrLength, nameLength, dataOffset, attr.header);
 
       // --- attribute ---
-      QWORD createdFiletime = Utils::readLittleEndianVal<QWORD>(
-          entryRaw, firstAttrOffset + dataOffset);
-      QWORD modifiedFiletime = Utils::readLittleEndianVal<QWORD>(
-          entryRaw, firstAttrOffset + dataOffset + 0x8);
-
-      // --- Finished reading
-      firstAttrOffset += attrLength;
+      QWORD createdFiletime =
+          Utils::readLittleEndianVal<QWORD>(attrRaw, dataOffset);
+      QWORD modifiedFiletime =
+          Utils::readLittleEndianVal<QWORD>(attrRaw, dataOffset + 0x8);
 
     } else if (attrTypeID == 0x30) {  // $FILE_NAME
 
@@ -180,11 +235,10 @@ MftEntryAvailability Reader::readMftEntry(Index sectorNum, MftEntry &entry) {
       readAttrHeader(attrLength, nameLength, dataOffset, attr.header);
 
       // --- attribute ---
-      attr.parent =
-          Utils::readLittleEndianVal(entryRaw, firstAttrOffset + dataOffset, 6);
+      attr.parent = Utils::readLittleEndianVal(attrRaw, dataOffset, 6);
 
       DWORD filePermissons = Utils::readLittleEndianVal<DWORD>(
-          entryRaw, firstAttrOffset + dataOffset + 0x38);
+          attrRaw, dataOffset + 0x38);
 
       // Check flags in file attribute
       FileAttr &fa = attr.fileAttr;
@@ -205,25 +259,40 @@ MftEntryAvailability Reader::readMftEntry(Index sectorNum, MftEntry &entry) {
       if (filePermissons & (1 << 29)) fa.indexView = true;
 
       BYTE fileNameLength = Utils::readLittleEndianVal<BYTE>(
-          entryRaw, firstAttrOffset + dataOffset + 0x40);
+          attrRaw, dataOffset + 0x40);
       BYTE fileNameNamespace = Utils::readLittleEndianVal<BYTE>(
-          entryRaw, firstAttrOffset + dataOffset + 0x41);
+          attrRaw, dataOffset + 0x41);
 
       // If file name contain unicode
       if (fileNameNamespace == 0 || fileNameNamespace == 1) {
-        fileNameLength *= 2;
         attr.containsUnicode = true;
       }
 
-      attr.fileName = Utils::readRawString(
-          entryRaw, firstAttrOffset + dataOffset + 0x42, fileNameLength);
+      // UTF-16 in every namespace, DOS names just stick to ASCII
+      const BYTE *fileName = attrRaw + dataOffset + 0x42;
+      attr.fileName.assign(fileName, fileName + fileNameLength * 2);
+
+    } else if (attrTypeID == 0x80 && attr.lowestVcn() != 0) {
 
-      // --- Finished reading
-      firstAttrOffset += attrLength;
+      // Rest of a $DATA split across records, its runs go after the part
+      // that starts at VCN 0
+      for (DataAttribute &dataAttr : entry.dataAttrs) {
+        const BYTE *name = attr.name();
+        if (!dataAttr.header.isNonResident ||
+            dataAttr.header.name !=
+                ArenaString(name, name + attr.nameLength() * 2, allocator)) {
+          continue;
+        }
+
+        appendRuns(attr, dataAttr.dataRuns);
+        break;
+      }
 
     } else if (attrTypeID == 0x80) {  // $DATA
 
       DataAttribute dataAttr;
+      dataAttr.header.name = ArenaString(allocator);
+      dataAttr.dataRuns = ArenaVector<DataRun>(allocator);
 
       // --- header ---
       DWORD attrLength;
@@ -233,99 +302,46 @@ MftEntryAvailability Reader::readMftEntry(Index sectorNum, MftEntry &entry) {
 
       // --- attribute ---
       if (dataAttr.header.isNonResident) {
-        dataAttr.realSize =
-            Utils::readLittleEndianVal<QWORD>(entryRaw, firstAttrOffset + 0x30);
-
-        int offsetWithinData = 0;
-        BYTE allocatedBytes = Utils::readLittleEndianVal<BYTE>(
-            entryRaw, firstAttrOffset + dataOffset + offsetWithinData);
-
-        while (allocatedBytes != 0) {
-          DataRun dataRun;
-
-          int clusterCountInfoSize = allocatedBytes % 16;
-          int firstClusterInfoSize = allocatedBytes / 16;
-
-          dataRun.clusterCount = Utils::readLittleEndianVal(
-              entryRaw, firstAttrOffset + dataOffset + offsetWithinData + 0x1,
-              clusterCountInfoSize);
-          dataRun.firstCluster = Utils::readLittleEndianVal(
-              entryRaw,
-              firstAttrOffset + dataOffset + offsetWithinData + 0x1 +
-                  clusterCountInfoSize,
-              firstClusterInfoSize);
-
-          dataAttr.dataRuns.push_back(dataRun);
-
-          offsetWithinData += clusterCountInfoSize + firstClusterInfoSize + 1;
-          allocatedBytes = Utils::readLittleEndianVal<BYTE>(
-              entryRaw, firstAttrOffset + dataOffset + offsetWithinData);
+        dataAttr.realSize = Utils::readLittleEndianVal<QWORD>(attrRaw, 0x30);
+        dataAttr.allocatedSize =
+            Utils::readLittleEndianVal<QWORD>(attrRaw, 0x28);
+
+        WORD attrFlags = Utils::readLittleEndianVal<WORD>(attrRaw, 0xC);
+        if (attrFlags & 0x00FF) {
+          dataAttr.compressionUnit =
+              Utils::readLittleEndianVal<WORD>(attrRaw, 0x22);
         }
+
+        appendRuns(attr, dataAttr.dataRuns);
+      } else if (const BYTE *value = attr.value()) {
+        dataAttr.residentDataSize = attr.valueLength();
+        dataAttr.residentDataOffset = recordsOffset(value);
       } else {
-        dataAttr.residentDataSize =
-            Utils::readLittleEndianVal<DWORD>(entryRaw, firstAttrOffset + 0x10);
+        dataAttr.residentDataSize = 0;
       }
 
-      entry.dataAttrs.push_back(dataAttr);
+      entry.dataAttrs.push_back(std::move(dataAttr));
 
-      // --- Finished reading
-      firstAttrOffset += attrLength;
+    }
+  }
 
-    } else if (attrTypeID == 0xFFFFFFFF) {
-      break;
-    } else {  // Other Attributes
-      DWORD attrLength =
-          Utils::readLittleEndianVal<DWORD>(entryRaw, firstAttrOffset + 0x4);
+  // Resident values in extension records are looked up past the base record
+  entry.records.insert(entry.records.end(), extensions.begin(),
+                       extensions.end());
 
-      firstAttrOffset += attrLength;
+  // Only what the runs really occupy, holes left out
+  const QWORD clusterBytes = pbs.bpb.sectorsPerCluster * 512;
+  for (DataAttribute &dataAttr : entry.dataAttrs) {
+    dataAttr.diskSize = 0;
+    for (const DataRun &run : dataAttr.dataRuns) {
+      if (!run.sparse) dataAttr.diskSize += run.clusterCount * clusterBytes;
     }
   }
 
   return MftEntryAvailability::InUse;
 }
 
-// DirectoryNode Reader::generateDirectoryTree() {
-//   DirectoryNode test;
-//   const int NumberOfMetadataEntries = 30;
-//
-//   Index entryNum = 30;
-//   std::ifstream bitmapStream;
-//   DataRun bitmapDR = readBitmap(bitmapStream);
-//
-//   int totalEntries = 0;
-//
-//   for (int i = 0; i < bitmapDR.clusterCount; ++i) {
-//     BYTE byte;
-//     bitmapStream.read((char *)byte, 1);
-//
-//     int clusterEnd = pbs.bpb.sectorsPerCluster;
-//
-//     int j = 0;
-//     while (true) {
-//       if (!(byte & (1 << j))) {
-//         entryNum = (j + 1) * clusterEnd;
-//         continue;
-//       }
-//
-//       for (; entryNum < (j + 1) * clusterEnd; ++entryNum) {
-//         if (readMftEntry(entryNum)) {
-//           std::cout << "entry num " << entryNum << std::endl;
-//           ++totalEntries;
-//         } else {
-//           std::cout << "SKIP " << entryNum << std::endl;
-//           entryNum = (j + 1) * clusterEnd;
-//           break;
-//         }
-//       }
-//
-//       ++j;
-//       if (j % 8 == 0) break;
-//     }
-//
-//     if (entryNum == pbs.bpb.sectorsPerCluster) }
-// }
-
-std::vector<DataRun> Reader::getEntrySegments() {
+ArenaVector<DataRun> Reader::getEntrySegments() {
   if (!hasRead) {
     throw std::runtime_error("No drive has been read");
   }
@@ -333,246 +349,1434 @@ std::vector<DataRun> Reader::getEntrySegments() {
   QWORD sectorNum = pbs.bpb.MftClusterNum * pbs.bpb.sectorsPerCluster;
 
   // --- Get the whole entry ---
-  std::vector<BYTE> entryRaw;
-  std::vector<DataRun> result;
+  std::vector<BYTE> scratch(entrySize * 512);
+  ArenaVector<DataRun> result;
+
+  loadEntry(sectorNum, scratch.data());
+  MftRecordView record(scratch.data(), scratch.size());
+  for (const DataRun &run : record.dataRuns()) result.push_back(run);
+
+  // --- A fragmented $MFT keeps the rest of its runs in extension records ---
+  // They sit in the part the base record maps, which is enough to find them
+  if (!record.find(0x20).isValid()) return result;
+
+  setMftExtents(result);
+
+  std::vector<AttributeView> attrs;
+  std::vector<BYTE> extensions;
+  collectAttributes(record, extensions, attrs);
+
+  result.clear();
+  for (const AttributeView &attr : attrs) {
+    if (attr.type() == 0x80 && attr.nameLength() == 0 &&
+        attr.isNonResident()) {
+      appendRuns(attr, result);
+    }
+  }
+
+  return result;
+}
 
-  entryRaw.reserve(entrySize);
+const std::vector<RecordRange> &Reader::getMftExtents() {
+  if (!mftExtents.empty()) return mftExtents;
 
-  bool isInvalidEntry = false;
-  for (int i = 0; i < entrySize; ++i) {
-    Sector sector;
-    curDrive.readSector(sectorNum + i, sector);
-    entryRaw.insert(entryRaw.end(), sector.begin(), sector.end());
+  setMftExtents(getEntrySegments());
+
+  return mftExtents;
+}
+
+void Reader::setMftExtents(const ArenaVector<DataRun> &runs) {
+  const Index sectorsPerCluster = pbs.bpb.sectorsPerCluster;
+  Index recordNum = 0;
+  ExtentMap extents(runs);
+
+  mftExtents.clear();
+  for (std::size_t i = 0; i < extents.size(); ++i) {
+    ExtentMap::Extent extent = extents[i];
+
+    // Runs hold whole clusters, and records never straddle a cluster as long
+    // as clusters are at least as big as a record
+    Index runRecords = extent.clusterCount * sectorsPerCluster / entrySize;
+    mftExtents.push_back(
+        {recordNum, extent.lcn * sectorsPerCluster, runRecords});
+    recordNum += runRecords;
+  }
+
+  mftRecordCount = recordNum;
+}
+
+Index Reader::getRecordSector(Index recordNum) {
+  const std::vector<RecordRange> &extents = getMftExtents();
+
+  auto it = std::upper_bound(extents.begin(), extents.end(), recordNum,
+                             [](Index record, const RecordRange &extent) {
+                               return record < extent.firstRecord;
+                             });
+  if (it == extents.begin() || recordNum >= mftRecordCount) {
+    throw std::runtime_error("Record is outside of the $MFT");
+  }
+
+  --it;
+  return it->firstSector + (recordNum - it->firstRecord) * entrySize;
+}
+
+Index Reader::loadExtensions(const AttributeView &list, Index baseRecord,
+                             std::vector<BYTE> &buffer) {
+  const std::size_t recordBytes = entrySize * 512;
+  const Index sectorsPerCluster = pbs.bpb.sectorsPerCluster;
+
+  // --- The list itself, resident or in clusters of its own ---
+  std::vector<BYTE> nonResident;
+  const BYTE *entries = list.value();
+  std::size_t length = list.valueLength();
+
+  if (list.isNonResident()) {
+    ExtentMap extents(list.dataRuns());
+
+    nonResident.resize(extents.clusterCount() * sectorsPerCluster * 512);
+    readClusters(extents, 0, extents.clusterCount(), nonResident.data());
+
+    entries = nonResident.data();
+    length = std::min<QWORD>(nonResident.size(), list.realSize());
+  }
+  if (entries == nullptr) return 0;
+
+  // --- Every record it points at other than the base one ---
+  getMftExtents();
+
+  std::vector<Index> records;
+  std::size_t offset = 0;
+  while (offset + 0x1A <= length) {
+    WORD entryLength = Utils::readLittleEndianVal<WORD>(entries, offset + 0x4);
+    if (entryLength < 0x1A) break;
+
+    Index record = Utils::readLittleEndianVal(entries, offset + 0x10, 6);
+    if (record != baseRecord && record < mftRecordCount) {
+      records.push_back(record);
+    }
+
+    offset += entryLength;
+  }
+
+  std::sort(records.begin(), records.end());
+  records.erase(std::unique(records.begin(), records.end()), records.end());
+
+  // --- Fetch them, one cache read per stretch that is contiguous on disk ---
+  buffer.resize(records.size() * recordBytes);
+
+  for (std::size_t i = 0; i < records.size();) {
+    Index firstSector = getRecordSector(records[i]);
+
+    std::size_t j = i + 1;
+    while (j < records.size() &&
+           getRecordSector(records[j]) == firstSector + (j - i) * entrySize) {
+      ++j;
+    }
+
+    cache->read(firstSector, (j - i) * entrySize,
+                buffer.data() + i * recordBytes);
+    i = j;
   }
 
-  WORD firstAttrOffset = Utils::readLittleEndianVal<WORD>(entryRaw, 0x14);
+  for (std::size_t i = 0; i < records.size(); ++i) {
+    BYTE *record = buffer.data() + i * recordBytes;
 
-  while (firstAttrOffset < 512 - sizeof(DWORD)) {
-    DWORD attrTypeID =
-        Utils::readLittleEndianVal<DWORD>(entryRaw, firstAttrOffset);
+    // Wipe the signature of torn records so nothing parses them
+    if (applyFixup(record, recordBytes) == FixupResult::Torn) {
+      std::memset(record, 0, 4);
+    }
+  }
+
+  return records.size();
+}
 
-    if (attrTypeID == 0xFFFFFFFF) break;
-    if (attrTypeID != 0x80) {
-      DWORD attrLength =
-          Utils::readLittleEndianVal<DWORD>(entryRaw, firstAttrOffset + 0x4);
+void Reader::collectAttributes(const MftRecordView &record,
+                               std::vector<BYTE> &extensions,
+                               std::vector<AttributeView> &attrs) {
+  Index extensionCount = 0;
 
-      firstAttrOffset += attrLength;
+  for (AttributeView attr : record.attributes()) {
+    if (attr.type() == 0x20) {  // $ATTRIBUTE_LIST
+      extensionCount =
+          loadExtensions(attr, record.recordNumber(), extensions);
+    } else {
+      attrs.push_back(attr);
+    }
+  }
+
+  for (Index i = 0; i < extensionCount; ++i) {
+    MftRecordView extension(extensions.data() + i * entrySize * 512,
+                            entrySize * 512);
+    if (!extension.isValid() ||
+        extension.baseRecord() != record.recordNumber()) {
       continue;
     }
 
-    WORD dataOffset =
-        Utils::readLittleEndianVal<WORD>(entryRaw, firstAttrOffset + 0x20);
+    for (AttributeView attr : extension.attributes()) attrs.push_back(attr);
+  }
 
-    int offsetWithinData = 0;
-    BYTE allocatedBytes = Utils::readLittleEndianVal<BYTE>(
-        entryRaw, firstAttrOffset + dataOffset + offsetWithinData);
+  // Parts of a split attribute have to be merged in VCN order
+  std::stable_sort(attrs.begin(), attrs.end(),
+                   [](const AttributeView &a, const AttributeView &b) {
+                     return a.lowestVcn() < b.lowestVcn();
+                   });
+}
 
-    while (allocatedBytes != 0) {
-      DataRun dataRun;
+void Reader::appendRuns(const AttributeView &piece,
+                        ArenaVector<DataRun> &runs) {
+  // The piece's run list starts again from cluster 0, make its first run
+  // relative to where the runs so far end
+  std::int64_t lastCluster = 0;
+  for (const DataRun &run : runs) lastCluster += run.firstCluster;
+
+  const BYTE *pos = piece.runList();
+  const BYTE *limit = piece.data() + piece.length();
+  std::size_t firstNew = runs.size();
+
+  // A batch at a time, so the vector (often in an arena) only grows by what
+  // was really decoded
+  DataRun batch[64];
+  while (pos != nullptr) {
+    std::size_t count = decodeDataRuns(pos, limit, batch, 64);
+    runs.insert(runs.end(), batch, batch + count);
+  }
 
-      int clusterCountInfoSize = allocatedBytes % 16;
-      int firstClusterInfoSize = allocatedBytes / 16;
+  // Sparse runs have no cluster to rebase
+  for (std::size_t i = firstNew; i < runs.size(); ++i) {
+    if (!runs[i].sparse) {
+      runs[i].firstCluster -= lastCluster;
+      break;
+    }
+  }
+}
 
-      dataRun.clusterCount = Utils::readLittleEndianVal(
-          entryRaw, firstAttrOffset + dataOffset + offsetWithinData + 0x1,
-          clusterCountInfoSize);
-      dataRun.firstCluster = Utils::readLittleEndianVal(
-          entryRaw,
-          firstAttrOffset + dataOffset + offsetWithinData + 0x1 +
-              clusterCountInfoSize,
-          firstClusterInfoSize);
+void Reader::readClusters(const ExtentMap &extents, QWORD vcn, QWORD count,
+                          BYTE *buffer) {
+  const std::size_t clusterBytes = pbs.bpb.sectorsPerCluster * 512;
 
-      result.push_back(dataRun);
+  while (count != 0) {
+    ExtentMap::Extent extent = extents.find(vcn);
+    if (extent.clusterCount == 0) {
+      throw std::runtime_error("Read past the end of the runs");
+    }
 
-      offsetWithinData += clusterCountInfoSize + firstClusterInfoSize + 1;
-      allocatedBytes = Utils::readLittleEndianVal<BYTE>(
-          entryRaw, firstAttrOffset + dataOffset + offsetWithinData);
+    QWORD n = std::min(count, extent.clusterCount);
+    if (extent.isSparse()) {  // nothing on disk
+      std::memset(buffer, 0, n * clusterBytes);
+    } else {
+      cache->read(extent.lcn * pbs.bpb.sectorsPerCluster,
+                  n * pbs.bpb.sectorsPerCluster, buffer);
     }
 
-    break;
+    buffer += n * clusterBytes;
+    vcn += n;
+    count -= n;
   }
+}
 
-  return result;
+void Reader::readBitmap() {
+  if (bitmapLoaded) return;
+
+  QWORD sectorNum = pbs.bpb.MftClusterNum * pbs.bpb.sectorsPerCluster;
+
+  std::vector<BYTE> scratch(entrySize * 512);
+  loadEntry(sectorNum, scratch.data());
+  MftRecordView record(scratch.data(), scratch.size());
+
+  AttributeView bitmap = record.find(0xB0);  // $BITMAP
+  if (!bitmap.isValid()) {
+    // leave it empty, every record is then looked at
+  } else if (!bitmap.isNonResident()) {
+    // --- Resident: the bits are right here ---
+    if (const BYTE *value = bitmap.value()) {
+      mftBitmap.assign(value, value + bitmap.valueLength());
+    }
+  } else {
+    // --- Non resident: read its clusters ---
+    ExtentMap extents(bitmap.dataRuns());
+    for (std::size_t i = 0; i < extents.size(); ++i) {
+      ExtentMap::Extent extent = extents[i];
+
+      std::size_t oldSize = mftBitmap.size();
+      mftBitmap.resize(oldSize +
+                       extent.clusterCount * pbs.bpb.sectorsPerCluster * 512);
+      if (extent.isSparse()) continue;  // left zeroed
+
+      curDrive.readRange(extent.lcn * pbs.bpb.sectorsPerCluster,
+                         extent.clusterCount * pbs.bpb.sectorsPerCluster,
+                         mftBitmap.data() + oldSize);
+    }
+
+    if (mftBitmap.size() > bitmap.realSize()) {
+      mftBitmap.resize(bitmap.realSize());
+    }
+  }
+
+  bitmapLoaded = true;
+}
+
+MftEntryAvailability Reader::parseNode(const BYTE *entryRaw,
+                                       NodeRecord &node) {
+  MftRecordView record(entryRaw, entrySize * 512);
+
+  // Check if this is an actual entry/record
+  if (!record.isValid()) return MftEntryAvailability::Invalid;
+  if (!record.isInUse())
+    return MftEntryAvailability::NotInUse;  // No purpose of continue reading
+
+  // Extension records hold attributes of another file, not a file of their own
+  if (record.baseRecord() != 0) return MftEntryAvailability::Invalid;
+
+  // --- Child ---
+  node.id = record.recordNumber();
+  node.isDirectory = record.isDirectory();
+
+  // --- Parent and name ---
+  FileNameView fileName = record.fileName();
+  if (fileName.isValid()) {
+    node.parent = fileName.parent();
+    node.hasParent = true;
+    node.name = fileName.name();
+    node.nameLength = fileName.nameLength();
+  }
+
+  return MftEntryAvailability::InUse;
+}
+
+void Reader::insertNode(const NodeRecord &node, DirectoryIndex &index) {
+  // Corrupt references must not make the index allocate for them
+  if (node.id >= mftRecordCount) return;
+
+  Index parent = DirectoryIndex::NoParent;
+  if (node.hasParent && node.parent < mftRecordCount) parent = node.parent;
+
+  index.add(node.id, parent, node.isDirectory, node.name, node.nameLength);
+}
+
+void Reader::parseStreams(const BYTE *entryRaw,
+                          ArenaVector<StreamRecord> &streams) {
+  MftRecordView record(entryRaw, entrySize * 512);
+  if (!record.isValid() || !record.isInUse()) return;
+
+  // Streams kept in an extension record belong to its base record
+  Index owner = record.baseRecord();
+  if (owner == 0) owner = record.recordNumber();
+
+  for (AttributeView attr : record.attributes()) {
+    // Further parts of a split stream were counted with the first one
+    if (attr.type() != 0x80 || attr.nameLength() == 0 ||
+        attr.lowestVcn() != 0) {
+      continue;
+    }
+
+    streams.push_back({owner, attr.name(), attr.nameLength(), attr.realSize()});
+  }
+}
+
+void Reader::insertStream(const StreamRecord &stream, DirectoryIndex &index) {
+  if (stream.id >= mftRecordCount) return;
+
+  index.addStream(stream.id, stream.name, stream.nameLength, stream.size);
+}
+
+bool Reader::isRecordInUse(Index recordNum) const {
+  // Without a usable $BITMAP every record has to be looked at
+  if (mftBitmap.empty()) return true;
+  if (recordNum / 8 >= mftBitmap.size()) return false;
+  return mftBitmap[recordNum / 8] & (1 << (recordNum % 8));
+}
+
+std::vector<RecordRange> Reader::splitMft(Index maxRecords) {
+  // Free stretches shorter than this are read through instead of splitting
+  // the read around them
+  const Index minGap = 16;
+
+  readBitmap();
+
+  std::vector<RecordRange> ranges;
+
+  for (const RecordRange &extent : getMftExtents()) {
+    Index recordNum = extent.firstRecord;
+    Index runSector = extent.firstSector;
+    Index runRecords = extent.recordCount;
+
+    Index i = 0;
+    while (i < runRecords) {
+      // --- Skip unused records, a whole bitmap byte at a time if we can ---
+      Index record = recordNum + i;
+      if (record % 8 == 0 && i + 8 <= runRecords && !mftBitmap.empty() &&
+          record / 8 < mftBitmap.size() && mftBitmap[record / 8] == 0) {
+        i += 8;
+        continue;
+      }
+      if (!isRecordInUse(record)) {
+        ++i;
+        continue;
+      }
+
+      // --- Grow the range until a long gap, the limit or the run's end ---
+      Index start = i;
+      Index end = i + 1;  // one past the last record in use
+      for (Index j = i + 1; j < runRecords && j - start < maxRecords; ++j) {
+        if (isRecordInUse(recordNum + j)) {
+          end = j + 1;
+        } else if (j - end + 1 >= minGap) {
+          break;
+        }
+      }
+
+      ranges.push_back(
+          {recordNum + start, runSector + start * entrySize, end - start});
+      i = end;
+    }
+  }
+
+  return ranges;
+}
+
+BYTE *Reader::loadRange(const RecordRange &range, std::vector<BYTE> &buffer) {
+  Index sectors = range.recordCount * entrySize;
+  buffer.resize(sectors * 512);
+
+  // Full scans go around the block cache so they don't evict what was
+  // browsed. Mapped chunks are copied too, the fixups go to the copy.
+  if (const BYTE *mapped = curDrive.viewRange(range.firstSector, sectors)) {
+    std::memcpy(buffer.data(), mapped, buffer.size());
+  } else {
+    curDrive.readRange(range.firstSector, sectors, buffer.data());
+  }
+
+  return buffer.data();
 }
 
-MftEntryAvailability Reader::createNode(Index sectorNum, HashMap &map) {
+void Reader::scanMft(const RecordVisitor &visitor, std::size_t chunkBytes) {
   if (!hasRead) {
     throw std::runtime_error("No drive has been read");
   }
 
-  // --- Get the whole entry ---
-  std::vector<BYTE> entryRaw;
+  const std::size_t recordBytes = entrySize * 512;
+  tornRecords = 0;
 
-  entryRaw.reserve(entrySize);
+  // Read whole records only, at least one per chunk
+  std::vector<BYTE> buffer;
+  for (const RecordRange &range :
+       splitMft(std::max<Index>(chunkBytes / recordBytes, 1))) {
+    BYTE *chunk = loadRange(range, buffer);
 
-  bool isInvalidEntry = false;
-  for (int i = 0; i < entrySize; ++i) {
-    Sector sector;
-    curDrive.readSector(sectorNum + i, sector);
+    // Split the chunk into records in place. Ranges read through short free
+    // stretches, whose records are left out here.
+    for (Index i = 0; i < range.recordCount; ++i) {
+      if (!isRecordInUse(range.firstRecord + i)) continue;
 
-    if (i == 0) {
-      // Check if this is an actual entry/record
-      std::string signature = Utils::readString(sector, 0, sizeof(DWORD));
-      if (signature != "FILE") {
-        isInvalidEntry = true;
-        break;
+      BYTE *record = chunk + i * recordBytes;
+      if (applyFixup(record, recordBytes) == FixupResult::Torn) {
+        ++tornRecords;
+        continue;
       }
+
+      visitor(range.firstRecord + i, record);
     }
+  }
+}
 
-    entryRaw.insert(entryRaw.end(), sector.begin(), sector.end());
+MftRecordView Reader::viewMftEntry(Index sectorNum, Arena &arena) {
+  if (!hasRead) {
+    throw std::runtime_error("No drive has been read");
   }
 
-  if (isInvalidEntry) return MftEntryAvailability::Invalid;
+  BYTE *entryRaw = arena.allocate<BYTE>(entrySize * 512);
+  if (loadEntry(sectorNum, entryRaw) == FixupResult::Torn) return {};
 
-  WORD flags = Utils::readLittleEndianVal<WORD>(entryRaw, 0x16);
-  if (!(flags & 1))
-    return MftEntryAvailability::NotInUse;  // No purpose of continue reading
+  return MftRecordView(entryRaw, entrySize * 512);
+}
+
+std::size_t Reader::getRecordSize() { return entrySize * 512; }
+
+Index Reader::getTornRecords() { return tornRecords; }
+
+void Reader::setThreadCount(unsigned count) {
+  if (count != threadCount) decompressPool.reset();
+  threadCount = count;
+}
+
+void Reader::setIoDepth(unsigned depth) {
+  if (depth != ioDepth) readEngine.reset();
+  ioDepth = depth;
+}
+
+AsyncReadEngine &Reader::getEngine() {
+  if (!readEngine.get()) {
+    readEngine.reset(curDrive.createAsyncEngine(ioDepth).release());
+  }
+
+  return *readEngine.get();
+}
+
+void Reader::drainEngine() {
+  AsyncReadEngine *engine = readEngine.get();
+  if (!engine) return;
+
+  try {
+    ReadCompletion completion;
+    while (engine->wait(completion)) {
+    }
+  } catch (std::runtime_error &) {
+    readEngine.reset();  // its destructor waits for the rest
+  }
+}
+
+void Reader::generateDirectoryTree(DirectoryIndex &index) {
+  if (!hasRead) {
+    throw std::runtime_error("No drive has been read");
+  }
+
+  const std::size_t recordBytes = entrySize * 512;
+  const Index recordsPerChunk =
+      std::max<Index>(1024 * 1024 / recordBytes, 1);
+
+  std::vector<RecordRange> ranges = splitMft(recordsPerChunk);
+
+  tornRecords = 0;
+
+  index.clear();
+  index.reserve(mftRecordCount);
+  index.add(5, DirectoryIndex::NoParent, true);
+
+  // Records 0-15 are reserved for the filesystem's metadata files
+  const Index firstUserRecord = 16;
+
+  if (threadCount == 1) {
+    ArenaVector<StreamRecord> streams;
+    scanMft([&](Index recordNum, const BYTE *record) {
+      if (recordNum < firstUserRecord) return;
+
+      NodeRecord node;
+      if (parseNode(record, node) == MftEntryAvailability::InUse) {
+        insertNode(node, index);
+      }
+
+      streams.clear();
+      parseStreams(record, streams);
+      for (const StreamRecord &stream : streams) insertStream(stream, index);
+    });
+
+    index.finalize();
+    return;
+  }
+
+  // --- Pipeline: read ahead -> parse on the pool -> merge here ---
+
+  ThreadPool pool(threadCount);
+
+  // A slot is a read buffer plus the right to have one chunk in flight. It
+  // only goes back to the reader once the chunk has been merged, so memory
+  // stays bounded by the ring no matter how large the $MFT is. The parse
+  // results of a chunk go to its slot's arena, which is reset with the slot.
+  const std::size_t ringSize =
+      std::max<std::size_t>(2 * pool.size() + 2, ioDepth);
+  std::vector<std::vector<BYTE>> ring(ringSize);
+  std::vector<Arena> arenas(ringSize);
+  BoundedQueue<std::size_t> freeSlots(ringSize);
+  BoundedQueue<ParsedChunk> parsed(ringSize);
+  for (std::size_t slot = 0; slot < ringSize; ++slot) freeSlots.push(slot);
+
+  auto parseAsync = [&](ParsedChunk chunk, const BYTE *source) {
+    pool.submit([&, source, chunk]() mutable {
+      const RecordRange &range = ranges[chunk.index];
+
+      try {
+        // Records from a mapped image are copied here, off the reader thread,
+        // so the fixups have somewhere to go
+        std::vector<BYTE> &buffer = ring[chunk.slot];
+        if (source != buffer.data()) {
+          buffer.assign(source, source + range.recordCount * recordBytes);
+        }
+
+        chunk.nodes = ArenaVector<NodeRecord>(&arenas[chunk.slot]);
+        chunk.nodes.reserve(range.recordCount);
+        chunk.streams = ArenaVector<StreamRecord>(&arenas[chunk.slot]);
+        for (Index j = 0; j < range.recordCount; ++j) {
+          if (!isRecordInUse(range.firstRecord + j)) continue;
+
+          BYTE *record = buffer.data() + j * recordBytes;
+          if (applyFixup(record, recordBytes) == FixupResult::Torn) {
+            ++chunk.tornRecords;
+            continue;
+          }
+
+          if (range.firstRecord + j < firstUserRecord) continue;
+
+          NodeRecord node;
+          if (parseNode(record, node) == MftEntryAvailability::InUse) {
+            chunk.nodes.push_back(node);
+          }
+          parseStreams(record, chunk.streams);
+        }
+      } catch (...) {
+        chunk.error = std::current_exception();
+      }
+
+      parsed.push(std::move(chunk));
+    });
+  };
+
+  // Mapped images have nothing to read ahead, the parsing threads copy
+  // each chunk out themselves
+  auto viewStage = [&] {
+    for (std::size_t i = 0; i < ranges.size(); ++i) {
+      std::size_t slot;
+      if (!freeSlots.pop(slot)) return;  // the merge stage gave up
+
+      // Null for a range past the end of a truncated image
+      const BYTE *source = curDrive.viewRange(
+          ranges[i].firstSector, ranges[i].recordCount * entrySize);
+      if (!source) throw std::runtime_error("Unable to read");
+
+      ParsedChunk chunk;
+      chunk.index = i;
+      chunk.slot = slot;
+      parseAsync(std::move(chunk), source);
+    }
+  };
+
+  // Otherwise keep up to ioDepth chunk reads queued on the device
+  auto readStage = [&] {
+    AsyncReadEngine *engine = &getEngine();
+    std::vector<std::size_t> slotOf(ranges.size());
+    std::size_t issued = 0;
+
+    try {
+      while (true) {
+        while (issued < ranges.size() &&
+               engine->inFlight() < engine->queueDepth()) {
+          // Only block for a slot when there is nothing else to wait for
+          std::size_t slot;
+          bool haveSlot = engine->inFlight() > 0 ? freeSlots.tryPop(slot)
+                                                 : freeSlots.pop(slot);
+          if (!haveSlot) break;
+
+          const RecordRange &range = ranges[issued];
+          ring[slot].resize(range.recordCount * recordBytes);
+          engine->submit({range.firstSector, range.recordCount * entrySize,
+                          ring[slot].data(), issued});
+          slotOf[issued++] = slot;
+        }
+
+        // Nothing in flight: either everything was read or the merge gave up
+        ReadCompletion completion;
+        if (!engine->wait(completion)) return;
+        if (!completion.ok) throw std::runtime_error("Unable to read");
+
+        ParsedChunk chunk;
+        chunk.index = completion.tag;
+        chunk.slot = slotOf[completion.tag];
+        parseAsync(std::move(chunk), ring[chunk.slot].data());
+      }
+    } catch (...) {
+      // The engine outlives the scan, what it still has in flight goes into
+      // the ring
+      drainEngine();
+      throw;
+    }
+  };
+
+  std::thread readerStage([&] {
+    try {
+      if (curDrive.viewRange(0, 1)) {
+        viewStage();
+      } else {
+        readStage();
+      }
+    } catch (...) {
+      ParsedChunk failed;
+      failed.error = std::current_exception();
+      parsed.push(std::move(failed));
+    }
+  });
+
+  // Chunks finish out of order; merging them in range order keeps the tree
+  // the same for any thread count
+  std::map<std::size_t, ParsedChunk> waiting;
+  std::size_t next = 0;
+  std::exception_ptr error;
+
+  while (next < ranges.size()) {
+    ParsedChunk chunk;
+    parsed.pop(chunk);
+    if (chunk.error) {
+      error = chunk.error;
+      break;
+    }
+
+    waiting.emplace(chunk.index, std::move(chunk));
+    while (!waiting.empty() && waiting.begin()->first == next) {
+      ParsedChunk &ready = waiting.begin()->second;
+      for (NodeRecord &node : ready.nodes) insertNode(node, index);
+      for (StreamRecord &stream : ready.streams) insertStream(stream, index);
+      tornRecords += ready.tornRecords;
+
+      std::size_t slot = ready.slot;
+      waiting.erase(waiting.begin());
+      arenas[slot].reset();
+      freeSlots.push(slot);
+      ++next;
+    }
+  }
+
+  freeSlots.close();
+  readerStage.join();
+  pool.wait();
+
+  if (error) std::rethrow_exception(error);
+
+  index.finalize();
+}
+
+std::vector<DirectoryEntry> Reader::listDirectory(Index recordNum) {
+  if (!hasRead) {
+    throw std::runtime_error("No drive has been read");
+  }
+
+  const std::size_t recordBytes = entrySize * 512;
+  const std::size_t clusterBytes = pbs.bpb.sectorsPerCluster * 512;
+
+  // --- The directory's record ---
+  std::vector<BYTE> buffer(recordBytes);
+  if (loadEntry(getRecordSector(recordNum), buffer.data()) ==
+      FixupResult::Torn) {
+    throw std::runtime_error("Record is torn");
+  }
+
+  MftRecordView record(buffer.data(), recordBytes);
+  if (!record.isValid() || !record.isInUse() || !record.isDirectory()) {
+    throw std::runtime_error("Not a directory");
+  }
+
+  std::vector<AttributeView> attrs;
+  std::vector<BYTE> extensions;
+  collectAttributes(record, extensions, attrs);
+
+  // --- Its $I30 index: the root node, plus the blocks holding the rest ---
+  auto isI30 = [](const AttributeView &attr) {
+    static const BYTE name[] = {'$', 0, 'I', 0, '3', 0, '0', 0};
+    return attr.nameLength() == 4 && std::memcmp(attr.name(), name, 8) == 0;
+  };
+
+  AttributeView indexRoot;
+  ArenaVector<DataRun> runs;
+  for (const AttributeView &attr : attrs) {
+    if (attr.type() == 0x90 && isI30(attr)) indexRoot = attr;
+    if (attr.type() == 0xA0 && isI30(attr)) appendRuns(attr, runs);
+  }
+  ExtentMap allocation(runs);
+
+  if (!indexRoot.isValid() || indexRoot.value() == nullptr ||
+      indexRoot.valueLength() < 0x20) {
+    throw std::runtime_error("Directory has no index");
+  }
+
+  std::size_t blockBytes;
+  if (pbs.bpb.BytesPerIndexBlock.first) {
+    blockBytes = pbs.bpb.BytesPerIndexBlock.second;
+  } else {
+    blockBytes = pbs.bpb.clustersPerIdexBlock * clusterBytes;
+  }
+
+  // Blocks smaller than a cluster are addressed in 512-byte units
+  const std::size_t vcnBytes = blockBytes < clusterBytes ? 512 : clusterBytes;
+
+  // --- Walk the B+tree in order, which is the directory's sort order ---
+  std::vector<DirectoryEntry> children;
+  std::function<void(const BYTE *, std::size_t, int)> walkNode;
+  // Every block hangs off exactly one entry, a second visit means a loop
+  std::unordered_set<QWORD> visited;
+
+  auto walkBlock = [&](QWORD vcn, int depth) {
+    if (!visited.insert(vcn).second) {
+      throw std::runtime_error("Index block is referenced twice");
+    }
+
+    QWORD offset = vcn * vcnBytes;
+    QWORD firstCluster = offset / clusterBytes;
+    QWORD clusterCount =
+        (offset % clusterBytes + blockBytes + clusterBytes - 1) / clusterBytes;
+
+    std::vector<BYTE> clusters(clusterCount * clusterBytes);
+    readClusters(allocation, firstCluster, clusterCount, clusters.data());
+
+    BYTE *block = clusters.data() + offset % clusterBytes;
+    if (std::memcmp(block, "INDX", 4) != 0 ||
+        applyFixup(block, blockBytes) != FixupResult::Ok) {
+      throw std::runtime_error("Index block is corrupt");
+    }
+
+    // Node header right after the block header
+    walkNode(block + 0x18, blockBytes - 0x18, depth);
+  };
+
+  walkNode = [&](const BYTE *node, std::size_t nodeBytes, int depth) {
+    // Anything deeper than this is a loop in a corrupt index
+    if (depth > 32) throw std::runtime_error("Index is too deep");
+
+    DWORD entriesOffset = Utils::readLittleEndianVal<DWORD>(node, 0x0);
+    DWORD totalSize = Utils::readLittleEndianVal<DWORD>(node, 0x4);
+    std::size_t end = std::min<std::size_t>(totalSize, nodeBytes);
+
+    std::size_t offset = entriesOffset;
+    while (offset + 0x10 <= end) {
+      const BYTE *indexEntry = node + offset;
+      WORD entryLength = Utils::readLittleEndianVal<WORD>(indexEntry, 0x8);
+      WORD keyLength = Utils::readLittleEndianVal<WORD>(indexEntry, 0xA);
+      DWORD flags = Utils::readLittleEndianVal<DWORD>(indexEntry, 0xC);
+      if (entryLength < 0x10 || offset + entryLength > end) break;
+
+      // Entries in the subnode sort before this one
+      if (flags & 1) {
+        QWORD subnode = Utils::readLittleEndianVal<QWORD>(
+            indexEntry, entryLength - 0x8);
+        walkBlock(subnode, depth + 1);
+      }
+
+      if (flags & 2) break;  // last entry, no key
+
+      if (keyLength >= 0x42 && 0x10 + keyLength <= entryLength) {
+        FileNameView key(indexEntry + 0x10);
 
-  // --- Create child node ---
-  DWORD childTempId = Utils::readLittleEndianVal<DWORD>(entryRaw, 0x2C);
+        // DOS-only names duplicate a long name listed next to them
+        if (key.nameNamespace() != 2 &&
+            0x42 + key.nameLength() * 2 <= keyLength) {
+          DirectoryEntry child;
+          child.id = Utils::readLittleEndianVal(indexEntry, 0x0, 6);
+          child.isDirectory = key.flags() & (1 << 28);
+          child.realSize =
+              Utils::readLittleEndianVal<QWORD>(indexEntry, 0x10 + 0x30);
+          child.name.resize(key.nameLength());
+          std::memcpy(&child.name[0], key.name(), key.nameLength() * 2);
 
-  DirectoryNode *child;
-  // Child node hasn't exist
-  if (map.find(childTempId) == map.end()) {
-    child = new DirectoryNode;
-    child->id = childTempId;
-    if (flags & (1 << 1)) child->isDirectory = true;
-    map[child->id] = child;
-  } else {  // Child was add as an parent before
-    child = map[childTempId];
+          children.push_back(std::move(child));
+        }
+      }
+
+      offset += entryLength;
+    }
+  };
+
+  const BYTE *rootValue = indexRoot.value();
+  walkNode(rootValue + 0x10, indexRoot.valueLength() - 0x10, 0);
+
+  return children;
+}
+
+// Without anyone to tell about holes, they are written out as zeros, at most
+// bufferBytes at a time
+static HoleSink writeZeros(const ChunkSink &sink, std::size_t bufferBytes) {
+  auto zeros = std::make_shared<std::vector<BYTE>>();
+
+  return [&sink, bufferBytes, zeros](QWORD length) {
+    if (zeros->empty()) {
+      zeros->assign(std::max<QWORD>(std::min<QWORD>(length, bufferBytes), 1),
+                    0);
+    }
+
+    while (length > 0) {
+      std::size_t n = std::min<QWORD>(length, zeros->size());
+      sink(zeros->data(), n);
+      length -= n;
+    }
+  };
+}
+
+void Reader::readFile(const MftEntry &entry, const ChunkSink &sink,
+                      std::size_t bufferBytes) {
+  readFile(entry, sink, writeZeros(sink, bufferBytes), bufferBytes);
+}
+
+void Reader::readFile(const MftEntry &entry, const ChunkSink &sink,
+                      const HoleSink &hole, std::size_t bufferBytes) {
+  if (!hasRead) {
+    throw std::runtime_error("No drive has been read");
   }
 
-  WORD firstAttrOffset = Utils::readLittleEndianVal<WORD>(entryRaw, 0x14);
+  // Choose the unnamed data stream
+  for (const DataAttribute &data : entry.dataAttrs) {
+    if (data.header.name.empty()) {
+      readFile(entry, data, sink, hole, bufferBytes);
+      return;
+    }
+  }
+}
+
+void Reader::readStream(const MftEntry &entry, std::u16string_view name,
+                        const ChunkSink &sink, std::size_t bufferBytes) {
+  for (const DataAttribute &data : entry.dataAttrs) {
+    const ArenaString &dataName = data.header.name;
+    if (dataName.size() != name.size() * 2 ||
+        std::memcmp(dataName.data(), name.data(), dataName.size()) != 0) {
+      continue;
+    }
 
-  // --- Read Parent data ---
+    readFile(entry, data, sink, writeZeros(sink, bufferBytes), bufferBytes);
+    return;
+  }
 
-  while (firstAttrOffset < 512 - sizeof(DWORD)) {
-    DWORD attrTypeID =
-        Utils::readLittleEndianVal<DWORD>(entryRaw, firstAttrOffset);
+  throw std::runtime_error("No such stream");
+}
 
-    if (attrTypeID == 0xFFFFFFFF) break;
-    if (attrTypeID != 0x30) {
-      DWORD attrLength =
-          Utils::readLittleEndianVal<DWORD>(entryRaw, firstAttrOffset + 0x4);
+void Reader::readFile(const MftEntry &entry, const DataAttribute &data,
+                      const ChunkSink &sink, const HoleSink &hole,
+                      std::size_t bufferBytes) {
+  if (!hasRead) {
+    throw std::runtime_error("No drive has been read");
+  }
 
-      firstAttrOffset += attrLength;
+  // --- Resident: the content is in the record that was already loaded ---
+  if (!data.header.isNonResident) {
+    if (data.residentDataSize != 0) {
+      sink(entry.residentData(data), data.residentDataSize);
     }
+    return;
+  }
 
-    // $FILE_NAME
+  if (data.compressionUnit != 0) {
+    readCompressed(data, sink, hole, bufferBytes);
+    return;
+  }
 
-    // --- header ---
-    DWORD attrLength =
-        Utils::readLittleEndianVal<DWORD>(entryRaw, firstAttrOffset + 0x4);
-    WORD dataOffset =
-        Utils::readLittleEndianVal<WORD>(entryRaw, firstAttrOffset + 0x14);
+  // --- Non resident: cut the runs into pieces of at most one slot ---
+  // One slot per read kept in flight, they share bufferBytes
+  const std::size_t clusterBytes = pbs.bpb.sectorsPerCluster * 512;
+  const unsigned slotCount = std::max(ioDepth, 1u);
+  const QWORD slotClusters =
+      std::max<QWORD>(bufferBytes / slotCount / clusterBytes, 1);
+
+  struct Piece {
+    Index firstSector;
+    Index sectors;
+    QWORD bytes;  // of the file, the tail of the last cluster is cut
+    bool sparse;
+    unsigned slot;
+    bool done;
+  };
+
+  ExtentMap extents(data.dataRuns);
+  if (extents.clusterCount() * clusterBytes < data.realSize) {
+    throw std::runtime_error("Data runs end before the file does");
+  }
 
-    // --- attribute ---
+  // Pieces are cut as they are needed, so only those in flight are held
+  std::size_t extentIndex = 0;
+  QWORD extentDone = 0;  // clusters of that extent already cut
+  QWORD remaining = data.realSize;
 
-    // --- Create parent node ---
-    Index parentTempID =
-        Utils::readLittleEndianVal(entryRaw, firstAttrOffset + dataOffset, 6);
+  auto nextPiece = [&](Piece &piece) -> bool {
+    if (remaining == 0) return false;
 
-    // parent node exists
-    if (map.find(parentTempID) != map.end()) {
-      map[parentTempID]->children.push_back(child->id);
+    ExtentMap::Extent extent = extents[extentIndex];
+    QWORD n = extent.clusterCount - extentDone;
+    if (extent.isSparse()) {
+      // A hole is a single piece however long it is, it is never read
+      piece = {0, 0, 0, true, 0, false};
     } else {
-      DirectoryNode *parent = new DirectoryNode;
-      parent->id = parentTempID;
-      parent->isDirectory = true;
-      parent->children.push_back(child->id);
+      n = std::min(slotClusters, n);
+      piece = {(extent.lcn + extentDone) * pbs.bpb.sectorsPerCluster,
+               n * pbs.bpb.sectorsPerCluster, 0, false, 0, false};
+    }
+    piece.bytes = std::min<QWORD>(n * clusterBytes, remaining);
+    remaining -= piece.bytes;
+
+    extentDone += n;
+    if (extentDone == extent.clusterCount) {
+      ++extentIndex;
+      extentDone = 0;
+    }
+    return true;
+  };
+
+  // --- Mapped image: hand out the pages themselves ---
+  if (curDrive.viewRange(0, 1)) {
+    Piece piece;
+    while (nextPiece(piece)) {
+      if (piece.sparse) {
+        hole(piece.bytes);
+        continue;
+      }
 
-      map[parentTempID] = parent;
+      // Null for a run past the end of a truncated image
+      const BYTE *pages = curDrive.viewRange(piece.firstSector, piece.sectors);
+      if (!pages) throw std::runtime_error("Unable to read");
+      sink(pages, piece.bytes);
     }
-    break;
+    return;
   }
 
-  return MftEntryAvailability::InUse;
+  // --- Otherwise keep reads queued ahead of the sink, in a ring of slots ---
+  // Whole files go around the block cache, like scans do
+  AsyncReadEngine *engine = &getEngine();
+
+  std::vector<std::vector<BYTE>> ring(slotCount);
+  std::vector<unsigned> freeSlots;
+  for (unsigned slot = 0; slot < slotCount; ++slot) freeSlots.push_back(slot);
+
+  // Pieces issued but not emitted yet, in file order. The tag of a read is
+  // its piece's number in the file.
+  std::deque<Piece> window;
+  std::uint64_t firstTag = 0;
+  bool more = true;
+
+  try {
+    while (true) {
+      while (more && window.size() < slotCount && !freeSlots.empty() &&
+             engine->inFlight() < engine->queueDepth()) {
+        Piece piece;
+        more = nextPiece(piece);
+        if (!more) break;
+
+        if (!piece.sparse) {
+          piece.slot = freeSlots.back();
+          freeSlots.pop_back();
+
+          ring[piece.slot].resize(piece.sectors * 512);
+          engine->submit({piece.firstSector, piece.sectors,
+                          ring[piece.slot].data(), firstTag + window.size()});
+        }
+        window.push_back(piece);
+      }
+
+      if (window.empty()) break;
+
+      // Emit in file order, whatever order the reads finish in
+      const Piece &piece = window.front();
+      if (piece.sparse) {
+        hole(piece.bytes);
+      } else if (piece.done) {
+        sink(ring[piece.slot].data(), piece.bytes);
+        freeSlots.push_back(piece.slot);
+      } else {
+        ReadCompletion completion;
+        engine->wait(completion);
+        if (!completion.ok) throw std::runtime_error("Unable to read");
+
+        window[completion.tag - firstTag].done = true;
+        continue;
+      }
+
+      window.pop_front();
+      ++firstTag;
+    }
+  } catch (...) {
+    // The engine may still write into the ring, let it drain first
+    drainEngine();
+    throw;
+  }
 }
 
-void Reader::generateDirectoryTree(HashMap &map) {
-  DirectoryNode test;
+void Reader::readCompressed(const DataAttribute &data, const ChunkSink &sink,
+                            const HoleSink &hole, std::size_t bufferBytes) {
+  const std::size_t clusterBytes = pbs.bpb.sectorsPerCluster * 512;
+  const QWORD unitClusters = (QWORD)1 << data.compressionUnit;
+  const std::size_t unitBytes = unitClusters * clusterBytes;
+
+  ExtentMap extents(data.dataRuns);
+  const QWORD unitCount =
+      (extents.clusterCount() + unitClusters - 1) / unitClusters;
+  // The next batch is read while this one is decompressed, so each of the
+  // two gets half of bufferBytes
+  const QWORD batchUnits = std::max<QWORD>(bufferBytes / 2 / unitBytes, 1);
+
+  // A unit is stored as is when all its clusters are on disk, is a hole when
+  // none are, and is compressed into the first ones otherwise
+  struct Unit {
+    QWORD clusters;  // of the unit, the last one can be cut short
+    QWORD stored;    // of them on disk
+    std::vector<BYTE> raw;
+    std::vector<BYTE> decompressed;
+  };
+
+  struct Batch {
+    std::vector<Unit> units;
+    std::size_t count = 0;
+    std::size_t reads = 0;  // still in flight
+  };
+
+  Batch batches[2];
+  for (Batch &batch : batches) {
+    batch.units.resize(std::min(batchUnits, unitCount));
+  }
+
+  // Like whole files, units go around the block cache. Mapped images are
+  // copied from directly, anything else is read on the async engine with
+  // the reads a batch needs queued in order.
+  const bool mapped = curDrive.viewRange(0, 1) != nullptr;
+  AsyncReadEngine *engine = mapped ? nullptr : &getEngine();
+  std::deque<ReadRequest> queued;
+
+  auto submitQueued = [&] {
+    while (!queued.empty() && engine->inFlight() < engine->queueDepth()) {
+      engine->submit(queued.front());
+      queued.pop_front();
+    }
+  };
+
+  auto startBatch = [&](std::size_t b, QWORD first) {
+    Batch &batch = batches[b];
+    batch.count = std::min(batchUnits, unitCount - first);
+
+    for (std::size_t i = 0; i < batch.count; ++i) {
+      Unit &unit = batch.units[i];
+      QWORD vcn = (first + i) * unitClusters;
+      unit.clusters = std::min(unitClusters, extents.clusterCount() - vcn);
+
+      unit.stored = 0;
+      for (QWORD done = 0; done < unit.clusters;) {
+        ExtentMap::Extent extent = extents.find(vcn + done);
+        QWORD n = std::min(extent.clusterCount, unit.clusters - done);
+        if (!extent.isSparse()) unit.stored += n;
+        done += n;
+      }
+      unit.raw.resize(unit.stored * clusterBytes);
+
+      // What is on disk comes first in the unit, possibly over several runs
+      BYTE *buffer = unit.raw.data();
+      for (QWORD done = 0; done < unit.stored;) {
+        ExtentMap::Extent extent = extents.find(vcn + done);
+        QWORD n = std::min(extent.clusterCount, unit.stored - done);
+        Index firstSector = extent.lcn * pbs.bpb.sectorsPerCluster;
+        Index sectors = n * pbs.bpb.sectorsPerCluster;
+
+        if (mapped) {
+          curDrive.readRange(firstSector, sectors, buffer);
+        } else {
+          queued.push_back({firstSector, sectors, buffer, b});
+          ++batch.reads;
+        }
+        buffer += n * clusterBytes;
+        done += n;
+      }
+    }
+
+    if (engine) submitQueued();
+  };
+
+  auto finishBatch = [&](std::size_t b) {
+    while (batches[b].reads > 0) {
+      ReadCompletion completion;
+      engine->wait(completion);
+      if (!completion.ok) throw std::runtime_error("Unable to read");
+
+      --batches[completion.tag].reads;
+      submitQueued();
+    }
+  };
+
+  auto decompress = [&](Unit &unit) {
+    unit.decompressed.resize(unitBytes);
+    std::size_t n = decompressLznt1(unit.raw.data(), unit.raw.size(),
+                                    unit.decompressed.data(), unitBytes);
+    std::memset(unit.decompressed.data() + n, 0, unitBytes - n);
+  };
+
+  QWORD remaining = data.realSize;
+
+  try {
+    if (unitCount > 0 && remaining > 0) startBatch(0, 0);
+
+    std::size_t b = 0;
+    for (QWORD first = 0; first < unitCount && remaining > 0;
+         first += batchUnits, b ^= 1) {
+      Batch &batch = batches[b];
+      finishBatch(b);
+
+      // --- Get the next batch coming while this one is worked on ---
+      QWORD next = first + batchUnits;
+      if (next < unitCount && next * unitBytes < data.realSize) {
+        startBatch(b ^ 1, next);
+      }
+
+      // --- Decompress, on the pool when there's more than one unit to do ---
+      std::size_t compressed = 0;
+      for (std::size_t i = 0; i < batch.count; ++i) {
+        const Unit &unit = batch.units[i];
+        if (unit.stored != 0 && unit.stored < unit.clusters) ++compressed;
+      }
+
+      if (compressed > 1 && threadCount != 1) {
+        if (!decompressPool.get()) {
+          decompressPool.reset(new ThreadPool(threadCount));
+        }
+        ThreadPool &pool = *decompressPool.get();
+
+        for (std::size_t i = 0; i < batch.count; ++i) {
+          Unit &unit = batch.units[i];
+          if (unit.stored == 0 || unit.stored == unit.clusters) continue;
+          pool.submit([&decompress, &unit]() { decompress(unit); });
+        }
+        pool.wait();
+      } else if (compressed != 0) {
+        for (std::size_t i = 0; i < batch.count; ++i) {
+          Unit &unit = batch.units[i];
+          if (unit.stored != 0 && unit.stored < unit.clusters) {
+            decompress(unit);
+          }
+        }
+      }
+
+      // --- Hand the units out in order ---
+      for (std::size_t i = 0; i < batch.count && remaining > 0; ++i) {
+        const Unit &unit = batch.units[i];
+        QWORD bytes = std::min<QWORD>(unit.clusters * clusterBytes, remaining);
+
+        if (unit.stored == 0) {
+          hole(bytes);
+        } else if (unit.stored == unit.clusters) {
+          sink(unit.raw.data(), bytes);  // stored as is, nothing to undo
+        } else {
+          sink(unit.decompressed.data(), bytes);
+        }
+        remaining -= bytes;
+      }
+    }
+  } catch (...) {
+    // The engine may still write into the batches, let it drain first
+    if (engine) drainEngine();
+    throw;
+  }
 
-  DirectoryNode *root = new DirectoryNode;
-  root->id = 5;
-  map[5] = root;
-  std::vector<DataRun> segments = getEntrySegments();
+  if (remaining > 0) {
+    throw std::runtime_error("Data runs end before the file does");
+  }
+}
 
-  QWORD relativeCluster = 0;
-  for (DataRun &segment : segments) {
-    relativeCluster += segment.firstCluster;
-    int start = relativeCluster * pbs.bpb.sectorsPerCluster + 36;
-    int end = start + segment.clusterCount * pbs.bpb.sectorsPerCluster;
+void Reader::readFile(const MftEntry &entry, std::ostream &out) {
+  readFile(entry, [&](const BYTE *data, std::size_t length) {
+    out.write((const char *)data, length);
+    if (!out) throw std::runtime_error("Unable to write");
+  });
+}
 
-    for (int i = start; i < end; i += 2) {
-      createNode(i, map);
+void Reader::readFile(const MftEntry &entry, int fd) {
+  auto writeAll = [&](const BYTE *data, std::size_t length) {
+    while (length > 0) {
+#ifdef _WIN32
+      unsigned step = (unsigned)std::min<std::size_t>(length, 1u << 30);
+      int written = _write(fd, data, step);
+#else
+      ssize_t written = write(fd, data, length);
+      if (written < 0 && errno == EINTR) continue;
+#endif
+      if (written <= 0) throw std::runtime_error("Unable to write");
+
+      data += written;
+      length -= written;
     }
+  };
+
+#ifdef _WIN32
+  auto seek = [&](long long offset, int whence) {
+    return _lseeki64(fd, offset, whence);
+  };
+#else
+  auto seek = [&](long long offset, int whence) {
+    return (long long)lseek(fd, offset, whence);
+  };
+#endif
+
+  // Pipes can't have holes, zeros are written to them instead
+  if (seek(0, SEEK_CUR) < 0) {
+    readFile(entry, writeAll);
+    return;
+  }
+
+  // Holes are skipped over, leaving them unallocated in the output too
+  bool endsInHole = false;
+  readFile(
+      entry,
+      [&](const BYTE *data, std::size_t length) {
+        writeAll(data, length);
+        endsInHole = false;
+      },
+      [&](QWORD length) {
+        if (seek(length, SEEK_CUR) < 0) {
+          throw std::runtime_error("Unable to write");
+        }
+        endsInHole = true;
+      });
+
+  // Seeking alone doesn't grow the file over a trailing hole
+  if (endsInHole) {
+    long long end = seek(0, SEEK_CUR);
+#ifdef _WIN32
+    bool resized = _chsize_s(fd, end) == 0;
+#else
+    bool resized = ftruncate(fd, end) == 0;
+#endif
+    if (!resized) throw std::runtime_error("Unable to write");
   }
 }
 
 std::string Reader::readFile(MftEntry entry) {
   std::string result;
 
-  for (DataAttribute &da : entry.dataAttrs) {
-    // Choose the unnamed data stream
-    if (!da.header.name.empty()) continue;
+  readFile(entry, [&](const BYTE *data, std::size_t length) {
+    result.append((const char *)data, length);
+  });
+
+  return result;
+}
 
-    QWORD relativeCluster = 0;
+// --- Random access ---
 
-    for (DataRun &dr : da.dataRuns) {
-      relativeCluster += dr.firstCluster;
+// Reads count sectors of a file, counted from its start, into buffer
+static void readFileSectors(BlockCache &cache, const ExtentMap &extents,
+                            int sectorsPerCluster, QWORD sector, QWORD count,
+                            BYTE *buffer) {
+  while (count != 0) {
+    ExtentMap::Extent extent = extents.find(sector / sectorsPerCluster);
+    if (extent.clusterCount == 0) {
+      throw std::runtime_error("Read past the end of the runs");
     }
+
+    QWORD skipped = sector % sectorsPerCluster;
+    QWORD n =
+        std::min(count, extent.clusterCount * sectorsPerCluster - skipped);
+
+    if (extent.isSparse()) {
+      std::memset(buffer, 0, n * 512);
+    } else {
+      cache.read(extent.lcn * sectorsPerCluster + skipped, n, buffer);
+    }
+
+    buffer += n * 512;
+    sector += n;
+    count -= n;
   }
+}
 
-  return result;
+QWORD FileHandle::size() const { return fileSize; }
+
+std::size_t FileHandle::read(QWORD offset, BYTE *buffer, std::size_t length) {
+  if (offset >= fileSize) return 0;
+  length = std::min<QWORD>(length, fileSize - offset);
+  if (length == 0) return 0;
+
+  if (resident) {
+    std::memcpy(buffer, residentData.data() + offset, length);
+    return length;
+  }
+
+  // --- Whole sectors, straight into buffer when they line up with it ---
+  QWORD firstSector = offset / 512;
+  QWORD sectors = (offset + length + 511) / 512 - firstSector;
+
+  if (offset % 512 == 0 && length % 512 == 0) {
+    readFileSectors(*cache, *extents, sectorsPerCluster, firstSector, sectors,
+                    buffer);
+  } else {
+    scratch.resize(sectors * 512);
+    readFileSectors(*cache, *extents, sectorsPerCluster, firstSector, sectors,
+                    scratch.data());
+    std::memcpy(buffer, scratch.data() + offset % 512, length);
+  }
+
+  // --- Read ahead once a few reads followed each other ---
+  if (offset == nextOffset) {
+    ++streak;
+  } else {
+    streak = 0;
+    window = 0;
+    prefetchedTo = 0;
+  }
+  nextOffset = offset + length;
+
+  if (canPrefetch && streak >= 2) readAhead();
+
+  return length;
+}
+
+void FileHandle::readAhead() {
+  const std::size_t firstWindow = 128 * 1024;
+
+  // Far enough ahead still, or the last one is still running
+  if (prefetchedTo >= nextOffset + window / 2) return;
+  if (prefetch.valid()) {
+    if (prefetch.wait_for(std::chrono::seconds(0)) !=
+        std::future_status::ready) {
+      return;
+    }
+
+    // A failed read-ahead is not an error, the read itself will report it
+    try {
+      prefetch.get();
+    } catch (const std::exception &) {
+    }
+  }
+
+  window = window == 0 ? firstWindow : std::min(window * 2, MaxReadAhead);
+
+  QWORD from = std::max(prefetchedTo, nextOffset);
+  QWORD to = std::min<QWORD>(nextOffset + window, fileSize);
+  if (from >= to) return;
+  prefetchedTo = to;
+
+  // Whole clusters, which is what the cache keeps
+  const QWORD clusterBytes = sectorsPerCluster * 512;
+  QWORD firstSector = from / clusterBytes * sectorsPerCluster;
+  QWORD lastSector = (to + clusterBytes - 1) / clusterBytes * sectorsPerCluster;
+
+  std::shared_ptr<BlockCache> cache = this->cache;
+  std::shared_ptr<const ExtentMap> extents = this->extents;
+  int sectorsPerCluster = this->sectorsPerCluster;
+
+  prefetch = std::async(std::launch::async, [=]() {
+    std::vector<BYTE> buffer((lastSector - firstSector) * 512);
+    readFileSectors(*cache, *extents, sectorsPerCluster, firstSector,
+                    lastSector - firstSector, buffer.data());
+  });
 }
 
-// DataRun Reader::readBitmap(std::ifstream &bitmapStream) {
-//   if (!hasRead) {
-//     throw std::runtime_error("No drive has been read");
-//   }
-//
-//   std::vector<BYTE> entryRaw;
-//
-//   int id = 6;  // Default id of bitmap
-//   Index sectorNum;
-//   int entrySize;
-//
-//   if (pbs.bpb.BytesPerFileRecordSegment.first = true) {
-//     entrySize = (pbs.bpb.BytesPerFileRecordSegment.second / 512);
-//   } else {
-//     entrySize =
-//         pbs.bpb.clustersPerFileRecordSegment * pbs.bpb.sectorsPerCluster;
-//   }
-//
-//   entryRaw.reserve(entrySize);
-//   sectorNum =
-//       pbs.bpb.MftClusterNum * pbs.bpb.sectorsPerCluster + id * entrySize;
-//
-//   for (int i = 0; i < entrySize; ++i) {
-//     Sector sector;
-//     curDrive.readSector(sectorNum + i * entrySize, sector);
-//     entryRaw.insert(entryRaw.end(), sector.begin(), sector.end());
-//   }
-//
-//   WORD attrOffset = Utils::readLittleEndianVal<WORD>(entryRaw, 0x14);
-//   WORD dataOffset = Utils::readLittleEndianVal<WORD>(entryRaw, 0x14);
-//
-//   DataRun dr;
-//
-//   while (attrOffset < 512 - sizeof(DWORD)) {
-//     BYTE allocatedBytes = Utils::readLittleEndianVal<BYTE>(
-//         entryRaw, attrOffset + dataOffset + 0x0);
-//
-//     dr.clusterCount = Utils::readLittleEndianVal(
-//         entryRaw, attrOffset + dataOffset + 0x1, allocatedBytes % 16);
-//     dr.firstCluster = Utils::readLittleEndianVal(
-//         entryRaw, attrOffset + dataOffset + 0x1 + allocatedBytes % 16,
-//         allocatedBytes / 16);
-//   }
-//
-//   dr.firstSector = dr.firstCluster * pbs.bpb.sectorsPerCluster;
-//
-//   curDrive.readSector(dr.firstSector, bitmapStream);
-//
-//   return dr;
-// }
+FileHandle Reader::openFile(Index recordNum) {
+  if (!hasRead) {
+    throw std::runtime_error("No drive has been read");
+  }
+
+  MftEntry entry;
+  if (readMftEntry(getRecordSector(recordNum), entry) !=
+      MftEntryAvailability::InUse) {
+    throw std::runtime_error("Record is not in use");
+  }
+
+  const DataAttribute *data = nullptr;
+  for (const DataAttribute &da : entry.dataAttrs) {
+    if (da.header.name.empty()) {
+      data = &da;
+      break;
+    }
+  }
+  if (data == nullptr) throw std::runtime_error("File has no data");
+
+  FileHandle handle;
+  handle.cache = cache;
+  handle.sectorsPerCluster = pbs.bpb.sectorsPerCluster;
+
+  if (!data->header.isNonResident) {
+    const BYTE *bytes = entry.residentData(*data);
+
+    handle.resident = true;
+    handle.residentData.assign(bytes, bytes + data->residentDataSize);
+    handle.fileSize = data->residentDataSize;
+    return handle;
+  }
+
+  if (data->compressionUnit != 0) {
+    throw std::runtime_error("Compressed files can't be read at an offset");
+  }
+
+  handle.fileSize = data->realSize;
+  handle.extents = std::make_shared<const ExtentMap>(data->dataRuns);
+
+  // Pointless over a mapped image, and a small cache would only evict what
+  // was fetched before it is read
+  handle.canPrefetch = !curDrive.viewRange(0, 1) &&
+                       cacheBudget >= 4 * FileHandle::MaxReadAhead;
+
+  return handle;
+}
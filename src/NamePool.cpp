@@ -0,0 +1,86 @@
+#include "NamePool.hpp"
+
+#include <cstring>
+#include <vector>
+
+#include "Global.hpp"
+
+using namespace Ntfs;
+
+std::size_t NamePool::hash(const char16_t *name, std::size_t length) {
+  // FNV-1a over the code units
+  std::uint64_t h = 14695981039346656037ull;
+  for (std::size_t i = 0; i < length; ++i) {
+    h ^= name[i];
+    h *= 1099511628211ull;
+  }
+
+  return (std::size_t)(h ^ (h >> 32));
+}
+
+void NamePool::rehash(std::size_t capacity) {
+  std::vector<Handle> old;
+  old.swap(table);
+  table.assign(capacity, Handle());
+
+  for (const Handle &handle : old) {
+    if (handle.length == 0) continue;
+
+    std::size_t slot =
+        hash(units.data() + handle.offset, handle.length) & (capacity - 1);
+    while (table[slot].length != 0) slot = (slot + 1) & (capacity - 1);
+    table[slot] = handle;
+  }
+}
+
+void NamePool::clear() {
+  units.clear();
+  table.clear();
+  distinct = 0;
+}
+
+void NamePool::reserve(std::size_t codeUnits) { units.reserve(codeUnits); }
+
+NamePool::Handle NamePool::add(const BYTE *name, BYTE length) {
+  if (length == 0) return Handle();
+
+  if ((distinct + 1) * 2 > table.size()) {
+    rehash(table.empty() ? 1024 : table.size() * 2);
+  }
+
+  // The units are copied first: a record's name may not be 2-byte aligned
+  std::size_t offset = units.size();
+  units.resize(offset + length);
+  std::memcpy(units.data() + offset, name, length * sizeof(char16_t));
+  const char16_t *copy = units.data() + offset;
+
+  // --- Already in: forget the copy ---
+  std::size_t mask = table.size() - 1;
+  std::size_t slot = hash(copy, length) & mask;
+  for (; table[slot].length != 0; slot = (slot + 1) & mask) {
+    const Handle &other = table[slot];
+    if (other.length == length &&
+        std::memcmp(units.data() + other.offset, copy,
+                    length * sizeof(char16_t)) == 0) {
+      units.resize(offset);
+      return other;
+    }
+  }
+
+  // --- New: keep it ---
+  Handle handle;
+  handle.offset = (std::uint32_t)offset;
+  handle.length = length;
+  table[slot] = handle;
+  ++distinct;
+
+  return handle;
+}
+
+std::u16string_view NamePool::get(Handle handle) const {
+  if (handle.length == 0) return {};
+
+  return std::u16string_view(units.data() + handle.offset, handle.length);
+}
+
+std::size_t NamePool::size() const { return units.size(); }
@@ -0,0 +1,105 @@
+#include "PathResolver.hpp"
+
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "DirectoryIndex.hpp"
+#include "Global.hpp"
+
+using namespace Ntfs;
+
+PathResolver::PathResolver(const DirectoryIndex &index, char16_t separator)
+    : index(index), separator(separator), slots(index.size(), 0) {}
+
+std::uint32_t PathResolver::resolve(Index id) {
+  if (id >= slots.size()) return 0;
+
+  // --- Climb until a directory that is already resolved ---
+  // A loop in the parents (corrupt records) ends the climb as well
+  chain.clear();
+  for (Index dir = id; dir < slots.size() && slots[dir] == 0;) {
+    if (chain.size() > slots.size()) break;
+    chain.push_back(dir);
+
+    Index parent = index.getParent(dir);
+    if (dir == Root || parent == dir) break;
+    dir = parent;
+  }
+
+  // --- Then back down, each one from its parent ---
+  for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+    Index dir = *it;
+    if (slots[dir] != 0) continue;
+
+    Directory entry = {dir, 0, 0};
+
+    if (dir != Root) {
+      // Parents that are unknown or part of a loop put the directory at
+      // the top
+      Index parent = index.getParent(dir);
+      std::uint32_t parentLength = 0;
+      if (parent < slots.size() && slots[parent] != 0) {
+        entry.parent = slots[parent];
+        parentLength = directories[entry.parent - 1].length;
+      }
+
+      entry.length =
+          parentLength + 1 + (std::uint32_t)index.getName(dir).size();
+    }
+
+    directories.push_back(entry);
+    slots[dir] = (std::uint32_t)directories.size();
+  }
+
+  return slots[id];
+}
+
+void PathResolver::appendDirectory(std::uint32_t slot, std::u16string &out) {
+  std::size_t end = out.size() + directories[slot - 1].length;
+  out.resize(end);
+
+  // Names from the directory up, each one in front of the last
+  char16_t *pos = &out[0] + end;
+  for (; slot != 0; slot = directories[slot - 1].parent) {
+    const Directory &dir = directories[slot - 1];
+    if (dir.id == Root) break;
+
+    std::u16string_view name = index.getName(dir.id);
+    pos -= name.size();
+    std::memcpy(pos, name.data(), name.size() * sizeof(char16_t));
+    *--pos = separator;
+  }
+}
+
+std::u16string_view PathResolver::directoryPath(Index id) {
+  scratch.clear();
+  if (std::uint32_t slot = resolve(id)) appendDirectory(slot, scratch);
+
+  return scratch;
+}
+
+void PathResolver::appendPath(Index id, std::u16string &out) {
+  if (!index.contains(id)) return;
+
+  if (index.isDirectory(id)) {
+    if (std::uint32_t slot = resolve(id)) appendDirectory(slot, out);
+    return;
+  }
+
+  Index parent = index.getParent(id);
+  if (parent != DirectoryIndex::NoParent) {
+    if (std::uint32_t slot = resolve(parent)) appendDirectory(slot, out);
+  }
+
+  out.push_back(separator);
+  out.append(index.getName(id));
+}
+
+std::u16string PathResolver::getPath(Index id) {
+  std::u16string path;
+  appendPath(id, path);
+
+  return path;
+}
@@ -0,0 +1,123 @@
+#include "ThreadPool.hpp"
+
+#include <utility>
+
+namespace {
+// Pool and deque of the worker running on this thread, if any
+thread_local const ThreadPool *currentPool = nullptr;
+thread_local std::size_t currentWorker = 0;
+}  // namespace
+
+ThreadPool::ThreadPool(unsigned threadCount) {
+  if (threadCount == 0) threadCount = std::thread::hardware_concurrency();
+  if (threadCount == 0) threadCount = 1;
+
+  for (unsigned i = 0; i < threadCount; ++i) {
+    queues.push_back(std::make_unique<Queue>());
+  }
+  for (unsigned i = 0; i < threadCount; ++i) {
+    workers.emplace_back(&ThreadPool::workerLoop, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    stopping = true;
+  }
+  wakeUp.notify_all();
+
+  for (std::thread &worker : workers) worker.join();
+}
+
+unsigned ThreadPool::size() const { return (unsigned)workers.size(); }
+
+void ThreadPool::submit(std::function<void()> task) {
+  std::size_t target;
+  if (currentPool == this) {
+    target = currentWorker;
+  } else {
+    target = nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+  }
+
+  // Count the task before it is visible, so a worker taking it right away
+  // can't decrement the counters below zero
+  {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    ++queued;
+    ++pending;
+  }
+  {
+    std::lock_guard<std::mutex> lock(queues[target]->mutex);
+    queues[target]->tasks.push_back(std::move(task));
+  }
+  wakeUp.notify_one();
+}
+
+bool ThreadPool::runOne(std::size_t self) {
+  std::function<void()> task;
+
+  // Own work first, oldest task first
+  {
+    std::lock_guard<std::mutex> lock(queues[self]->mutex);
+    if (!queues[self]->tasks.empty()) {
+      task = std::move(queues[self]->tasks.front());
+      queues[self]->tasks.pop_front();
+    }
+  }
+
+  // Then steal the newest task of someone else
+  for (std::size_t i = 1; !task && i < queues.size(); ++i) {
+    Queue &victim = *queues[(self + i) % queues.size()];
+
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      task = std::move(victim.tasks.back());
+      victim.tasks.pop_back();
+    }
+  }
+
+  if (!task) return false;
+
+  {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    --queued;
+  }
+
+  std::exception_ptr error;
+  try {
+    task();
+  } catch (...) {
+    error = std::current_exception();
+  }
+
+  std::lock_guard<std::mutex> lock(stateMutex);
+  if (error && !firstError) firstError = error;
+  if (--pending == 0) allDone.notify_all();
+
+  return true;
+}
+
+void ThreadPool::workerLoop(std::size_t self) {
+  currentPool = this;
+  currentWorker = self;
+
+  while (true) {
+    if (runOne(self)) continue;
+
+    std::unique_lock<std::mutex> lock(stateMutex);
+    wakeUp.wait(lock, [&] { return stopping || queued > 0; });
+    if (stopping && queued == 0) return;
+  }
+}
+
+void ThreadPool::wait() {
+  std::unique_lock<std::mutex> lock(stateMutex);
+  allDone.wait(lock, [&] { return pending == 0; });
+
+  if (firstError) {
+    std::exception_ptr error = firstError;
+    firstError = nullptr;
+    std::rethrow_exception(error);
+  }
+}
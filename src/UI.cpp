@@ -1,6 +1,7 @@
 #include "UI.hpp"
 
 #include <chrono>
+#include <cstring>
 #include <ftxui/component/animation.hpp>
 #include <ftxui/component/captured_mouse.hpp>
 #include <ftxui/component/component.hpp>
@@ -35,26 +36,24 @@ struct File {
 };
 
 struct Directory {
-  Ntfs::DirectoryNode parent;
+  Index parent;
   std::vector<File> children;
 };
 
-void readDirectory(Ntfs::DirectoryNode root, Ntfs::Reader reader) {
-  for (auto &child : root.children) {
+void readDirectory(const Ntfs::DirectoryIndex &index, Index directory,
+                   Ntfs::Reader reader) {
+  for (Index child : index.children(directory)) {
     Ntfs::MftEntry entry;
     if (reader.readMftEntry(child, entry) ==
         Ntfs::MftEntryAvailability::InUse) {
       File f;
       f.isDirectory = entry.header.isDirectory;
 
-      if (entry.fileNameAttr.containsUnicode = true) {
-        f.name = std::wstring(entry.fileNameAttr.fileName.begin(),
-                              entry.fileNameAttr.fileName.end());
-      } else {
-        std::string name(entry.fileNameAttr.fileName.begin(),
-                         entry.fileNameAttr.fileName.end());
-        f.name = Utils::StringToWString(name);
-      }
+      // Names are UTF-16LE whatever their namespace, not one char per byte
+      const ArenaVector<BYTE> &rawName = entry.fileNameAttr.fileName;
+      std::u16string name(rawName.size() / 2, u'\0');
+      std::memcpy(&name[0], rawName.data(), name.size() * 2);
+      f.name = Utils::utf16ToWString(name);
 
       f.dateModified =
           Utils::filetimeToFormattedString(entry.stdInfoAttr.modifiedTime);
@@ -423,14 +422,14 @@ void displayInputScreen() {
 
   auto renderer = Renderer(component, [&] {
     if (errorMsg.empty())
-      return vbox({hbox({text("Enter drive letter: "),
-                         input->Render() | size(WIDTH, EQUAL, 4)}),
+      return vbox({hbox({text("Enter drive letter or image path: "),
+                         input->Render() | size(WIDTH, EQUAL, 32)}),
                    hbox({filler(), okButton->Render() | size(WIDTH, EQUAL, 4),
                          filler()})}) |
              border | center;
     else
-      return vbox({hbox({text("Enter drive letter: "),
-                         input->Render() | size(WIDTH, EQUAL, 4)}),
+      return vbox({hbox({text("Enter drive letter or image path: "),
+                         input->Render() | size(WIDTH, EQUAL, 32)}),
                    hbox({filler(), okButton->Render() | size(WIDTH, EQUAL, 4),
                          filler()}),
                    text(errorMsg)}) |
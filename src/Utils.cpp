@@ -4,6 +4,7 @@
 
 #include <algorithm>
 #include <chrono>
+#include <cstring>
 #include <iomanip>
 #include <iterator>
 #include <sstream>
@@ -12,6 +13,12 @@
 
 #include "Global.hpp"
 
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define UTILS_HAVE_SSE2
+#endif
+
 namespace Utils {
 
 OS getOSName() {
@@ -86,7 +93,8 @@ Index readLittleEndianVal(const std::vector<BYTE> &byteArr, int start,
 
   Index result = 0;
   for (int i = start; i < start + length; i++) {
-    result |= (byteArr[i] << ((i - start) * bitsPerByte));
+    // Widen before shifting, a byte is promoted to int otherwise
+    result |= ((Index)byteArr[i] << ((i - start) * bitsPerByte));
   }
 
   return result;
@@ -97,6 +105,30 @@ template WORD readLittleEndianVal(const std::vector<BYTE> &, int);
 template DWORD readLittleEndianVal(const std::vector<BYTE> &, int);
 template QWORD readLittleEndianVal(const std::vector<BYTE> &, int);
 
+template <typename T>
+T readLittleEndianVal(const BYTE *bytes, int start) {
+  T result;
+  std::memcpy(&result, bytes + start, sizeof(T));
+
+  return result;
+}
+
+template BYTE readLittleEndianVal(const BYTE *, int);
+template WORD readLittleEndianVal(const BYTE *, int);
+template DWORD readLittleEndianVal(const BYTE *, int);
+template QWORD readLittleEndianVal(const BYTE *, int);
+
+Index readLittleEndianVal(const BYTE *bytes, int start, int length) {
+  const int bitsPerByte = 8;
+
+  Index result = 0;
+  for (int i = start; i < start + length; i++) {
+    result |= ((Index)bytes[i] << ((i - start) * bitsPerByte));
+  }
+
+  return result;
+}
+
 // Implementations of the above template
 template BYTE readLittleEndianVal(const Sector &, int);
 template WORD readLittleEndianVal(const Sector &, int);
@@ -118,12 +150,20 @@ std::string readString(const std::vector<BYTE> &byteArr, int start,
   return std::string(byteArr.begin() + start, byteArr.begin() + start + length);
 }
 
+std::string readString(const BYTE *bytes, int start, int length) {
+  return std::string(bytes + start, bytes + start + length);
+}
+
 std::vector<BYTE> readRawString(const std::vector<BYTE> &byteArr, int start,
                                 int length) {
   return std::vector<BYTE>(byteArr.begin() + start,
                            byteArr.begin() + start + length);
 }
 
+std::vector<BYTE> readRawString(const BYTE *bytes, int start, int length) {
+  return std::vector<BYTE>(bytes + start, bytes + start + length);
+}
+
 std::vector<BYTE> readRawWString(const std::vector<BYTE> &byteArr, int start,
                                  int length) {
   return std::vector<BYTE>(byteArr.begin() + start,
@@ -202,6 +242,159 @@ std::string filetimeToFormattedString(std::uint64_t fileTime) {
   return date::format("%F %R", filetimeToSystemclock(fileTime));
 }
 
+// --- Text ---
+
+static const char32_t replacementChar = 0xFFFD;
+
+static char *encodeUtf8(char32_t c, char *out) {
+  if (c < 0x80) {
+    *out++ = (char)c;
+  } else if (c < 0x800) {
+    *out++ = (char)(0xC0 | c >> 6);
+    *out++ = (char)(0x80 | (c & 0x3F));
+  } else if (c < 0x10000) {
+    *out++ = (char)(0xE0 | c >> 12);
+    *out++ = (char)(0x80 | (c >> 6 & 0x3F));
+    *out++ = (char)(0x80 | (c & 0x3F));
+  } else {
+    *out++ = (char)(0xF0 | c >> 18);
+    *out++ = (char)(0x80 | (c >> 12 & 0x3F));
+    *out++ = (char)(0x80 | (c >> 6 & 0x3F));
+    *out++ = (char)(0x80 | (c & 0x3F));
+  }
+
+  return out;
+}
+
+// Code point at text[i], moving i past it
+static char32_t decodeUtf16(std::u16string_view text, std::size_t &i) {
+  char32_t c = text[i++];
+  if (c < 0xD800 || c > 0xDFFF) return c;
+
+  if (c <= 0xDBFF && i < text.size() && text[i] >= 0xDC00 &&
+      text[i] <= 0xDFFF) {
+    return 0x10000 + ((c - 0xD800) << 10) + (text[i++] - 0xDC00);
+  }
+
+  return replacementChar;
+}
+
+void appendUtf8(std::u16string_view text, std::string &out) {
+  // Room for the worst case, 3 bytes per code unit, trimmed at the end
+  std::size_t start = out.size();
+  out.resize(start + text.size() * 3);
+  char *to = &out[0] + start;
+
+  const char16_t *units = text.data();
+  std::size_t i = 0;
+
+  while (i < text.size()) {
+    // --- Runs of ASCII, which most names are, several units at a time ---
+#ifdef UTILS_HAVE_SSE2
+    const __m128i nonAscii = _mm_set1_epi16((short)0xFF80);
+    while (i + 8 <= text.size()) {
+      __m128i block = _mm_loadu_si128((const __m128i *)(units + i));
+      __m128i high = _mm_and_si128(block, nonAscii);
+      if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, _mm_setzero_si128())) !=
+          0xFFFF) {
+        break;
+      }
+
+      _mm_storel_epi64((__m128i *)to, _mm_packus_epi16(block, block));
+      to += 8;
+      i += 8;
+    }
+#else
+    while (i + 4 <= text.size()) {
+      std::uint64_t block;
+      std::memcpy(&block, units + i, 8);
+      if (block & 0xFF80FF80FF80FF80ull) break;
+
+      for (int k = 0; k < 4; ++k) to[k] = (char)units[i + k];
+      to += 4;
+      i += 4;
+    }
+#endif
+    if (i == text.size()) break;
+
+    // --- Then one code point ---
+    to = encodeUtf8(decodeUtf16(text, i), to);
+  }
+
+  out.resize(to - out.data());
+}
+
+std::string utf16ToUtf8(std::u16string_view text) {
+  std::string result;
+  appendUtf8(text, result);
+
+  return result;
+}
+
+std::wstring utf16ToWString(std::u16string_view text) {
+  // Windows' wchar_t is UTF-16 already
+  if (sizeof(wchar_t) == 2) return std::wstring(text.begin(), text.end());
+
+  std::wstring result;
+  result.reserve(text.size());
+  for (std::size_t i = 0; i < text.size();) {
+    result.push_back((wchar_t)decodeUtf16(text, i));
+  }
+
+  return result;
+}
+
+std::wstring StringToWString(std::string str) {
+  std::wstring result;
+  result.reserve(str.size());
+
+  for (std::size_t i = 0; i < str.size();) {
+    BYTE lead = str[i];
+    int extra = -1;  // continuation bytes after the lead one
+    if (lead < 0x80) {
+      extra = 0;
+    } else if ((lead & 0xE0) == 0xC0) {
+      extra = 1;
+    } else if ((lead & 0xF0) == 0xE0) {
+      extra = 2;
+    } else if ((lead & 0xF8) == 0xF0) {
+      extra = 3;
+    }
+
+    // --- Decode one sequence, anything malformed is one replacement ---
+    char32_t c = replacementChar;
+    std::size_t length = 1;
+    if (extra >= 0 && i + extra < str.size()) {
+      char32_t value = extra == 0 ? lead : lead & (0x3F >> extra);
+      int k = 1;
+      for (; k <= extra; ++k) {
+        BYTE next = str[i + k];
+        if ((next & 0xC0) != 0x80) break;
+        value = value << 6 | (next & 0x3F);
+      }
+
+      // Overlong forms and surrogates are not valid UTF-8 either
+      static const char32_t minimum[] = {0, 0x80, 0x800, 0x10000};
+      if (k > extra && value >= minimum[extra] && value <= 0x10FFFF &&
+          (value < 0xD800 || value > 0xDFFF)) {
+        c = value;
+        length = extra + 1;
+      }
+    }
+    i += length;
+
+    // --- Encode it, as a surrogate pair where wchar_t is 16-bit ---
+    if (sizeof(wchar_t) == 2 && c >= 0x10000) {
+      result.push_back((wchar_t)(0xD800 + ((c - 0x10000) >> 10)));
+      result.push_back((wchar_t)(0xDC00 + ((c - 0x10000) & 0x3FF)));
+    } else {
+      result.push_back((wchar_t)c);
+    }
+  }
+
+  return result;
+}
+
 int countSetBits(int N) {
   int count = 0;
 